@@ -0,0 +1,75 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include "../src/mlp.hpp"
+#include <chrono>
+#include <random>
+#include <ratio>
+
+//Helpers shared by the benchmarks
+
+//Average wall time of one call of 'f' over 'repeats' calls, in seconds (or in Period units, e.g. std::milli)
+template <typename Period = std::ratio<1>, typename F>
+double time_per_call(int repeats, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++) f();
+    return std::chrono::duration<double, Period>(std::chrono::steady_clock::now() - start).count() / repeats;
+}
+
+//Gaussian blobs: each class has a random centre, samples are scattered around it (one-hot labels)
+inline void make_blob_dataset(Matrix& inputs, Matrix& targets, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<> centre_dis(-1.0, 1.0);
+    std::normal_distribution<> noise_dis(0.0, 0.6);
+
+    int num_features = inputs.get_columns();
+    int num_classes  = targets.get_columns();
+
+    Matrix centres(num_classes, num_features);
+    for (int c = 0; c < num_classes; c++) {
+        for (int j = 0; j < num_features; j++) {
+            centres(c, j) = centre_dis(gen);
+        }
+    }
+
+    for (int i = 0; i < inputs.get_rows(); i++) {
+        int c = i % num_classes;
+        for (int j = 0; j < num_features; j++) {
+            inputs(i, j) = centres(c, j) + noise_dis(gen);
+        }
+        targets(i, c) = 1.0;
+    }
+}
+
+//Index of the largest entry of a row (predicted or actual class)
+inline int argmax_row(const Matrix& mat, int row) {
+    int best = 0;
+    for (int j = 1; j < mat.get_columns(); j++) {
+        if (mat(row, j) > mat(row, best)) best = j;
+    }
+    return best;
+}
+
+//Fraction of rows whose predicted class matches the one-hot target
+inline double accuracy(MLP& mlp, const Matrix& inputs, const Matrix& targets) {
+    Matrix predictions = mlp.predict(inputs);
+    int correct = 0;
+
+    for (int i = 0; i < predictions.get_rows(); i++) {
+        if (argmax_row(predictions, i) == argmax_row(targets, i)) correct++;
+    }
+
+    return static_cast<double>(correct) / predictions.get_rows();
+}
+
+inline double max_abs_difference(const Matrix& a, const Matrix& b) {
+    double diff = 0.0;
+    for (int i = 0; i < a.get_rows(); i++) {
+        for (int j = 0; j < a.get_columns(); j++) {
+            diff = std::max(diff, std::abs(a(i, j) - b(i, j)));
+        }
+    }
+    return diff;
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include "../src/mlp.hpp"
+#include "../src/dataset_reader.hpp"
+#include "bench_util.hpp"
+
+//Compares fp64 and bf16 mixed precision training: GEMM speed of the forward pass, accuracy on a CSV
+//classification task read with DatasetReader::read_csv_classification and the bf16 model file round trip.
+//Exits with 1 when the bf16 test accuracy is more than ACCURACY_TOLERANCE below or above the fp64 one
+//
+//Usage: bf16_bench.exe [dataset.csv label1,label2,...]
+//Without arguments a noisy synthetic CSV (Gaussian blobs, string labels) is written and used
+
+const double ACCURACY_TOLERANCE = 0.01;
+
+//Gaussian blobs (make_blob_dataset) written as CSV: feature columns then a string label column, with a header row
+void write_blob_csv(const std::string& filename, int num_samples, int num_features, const std::vector<std::string>& labels, unsigned seed) {
+    Matrix inputs(num_samples, num_features);
+    Matrix targets(num_samples, static_cast<int>(labels.size()));
+    make_blob_dataset(inputs, targets, seed);
+
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("[-] ERROR: Unable to create file: " + filename);
+    }
+
+    for (int j = 0; j < num_features; j++) file << "x" << j << ",";
+    file << "label\n";
+
+    file << std::setprecision(17);
+    for (int i = 0; i < num_samples; i++) {
+        for (int j = 0; j < num_features; j++) {
+            file << inputs(i, j) << ",";
+        }
+        file << labels[argmax_row(targets, i)] << "\n";
+    }
+}
+
+std::vector<std::string> split_labels(const std::string& list) {
+    std::vector<std::string> labels;
+    std::istringstream iss(list);
+    std::string label;
+    while (std::getline(iss, label, ',')) labels.push_back(label);
+    return labels;
+}
+
+int main(int argc, char* argv[]) {
+    std::cout << "AVX-512 BF16: " << (cpu_has_avx512_bf16() ? "yes" : "no (conversion fallback)") << std::endl;
+
+    //= GEMM: batch x hidden times hidden x hidden =
+    {
+        int batch = 64, hidden = 1024;
+        Matrix a(batch, hidden), w(hidden, hidden);
+        a.set_random_weights();
+        w.set_random_weights();
+
+        BF16Matrix  a_bf16 = BF16Matrix::from_matrix(a);
+        BF16Weights w_bf16 = BF16Weights::from_matrix(w);
+        std::vector<float> mixed;
+
+        double fp64_time = time_per_call(3, [&]() { Matrix c = a * w; });
+        double bf16_time = time_per_call(3, [&]() { a_bf16.dot_product(w_bf16, mixed); });
+
+        Matrix exact = a * w;
+        double max_error = 0.0;
+        for (int i = 0; i < batch; i++) {
+            for (int j = 0; j < hidden; j++) {
+                max_error = std::max(max_error, std::abs(exact(i, j) - mixed[static_cast<size_t>(i) * hidden + j]));
+            }
+        }
+
+        std::cout << "== GEMM " << batch << "x" << hidden << " * " << hidden << "x" << hidden << " ==" << std::endl;
+        std::cout << "fp64: " << std::fixed << std::setprecision(4) << fp64_time * 1e3 << " ms" << std::endl;
+        std::cout << "bf16: " << bf16_time * 1e3 << " ms (max abs error " << max_error << ")" << std::endl;
+    }
+
+    //= Training accuracy =
+    std::string csv_file = "bf16_bench_data.csv";
+    std::vector<std::string> labels = { "north", "east", "south", "west" };
+    bool synthetic = argc < 3;
+
+    if (synthetic) {
+        write_blob_csv(csv_file, 3000, 32, labels, 7);
+    }
+    else {
+        csv_file = argv[1];
+        labels   = split_labels(argv[2]);
+    }
+
+    DatasetReader reader;
+    reader.read_csv_classification(csv_file, labels);
+    if (synthetic) std::remove(csv_file.c_str());
+
+    SplitData data = reader.train_test_split(0.2, 42);
+    Matrix& X_train = data.X_train;
+    Matrix& y_train = data.y_train;
+    Matrix& X_test  = data.X_test;
+    Matrix& y_test  = data.y_test;
+
+    int num_features = X_train.get_columns();
+    int num_classes  = y_train.get_columns();
+
+    //Same initial weights for both runs
+    MLP mlp_fp64({num_features, 128, num_classes});
+    MLP mlp_bf16 = mlp_fp64;
+    mlp_bf16.set_precision(Precision::BF16);
+
+    double learning_rate = 0.05;
+    int epochs = 20, batch_size = 16;
+
+    double fp64_train = time_per_call(1, [&]() { mlp_fp64.train(X_train, y_train, learning_rate, epochs, batch_size); });
+    double bf16_train = time_per_call(1, [&]() { mlp_bf16.train(X_train, y_train, learning_rate, epochs, batch_size); });
+
+    double fp64_accuracy = accuracy(mlp_fp64, X_test, y_test);
+    double bf16_accuracy = accuracy(mlp_bf16, X_test, y_test);
+
+    std::cout << "== Training (" << num_features << "-128-" << num_classes << ", " << epochs << " epochs) ==" << std::endl;
+    std::cout << "fp64: accuracy " << fp64_accuracy << ", " << fp64_train << " s" << std::endl;
+    std::cout << "bf16: accuracy " << bf16_accuracy << ", " << bf16_train << " s" << std::endl;
+
+    double accuracy_difference = std::abs(fp64_accuracy - bf16_accuracy);
+    bool within_tolerance = accuracy_difference <= ACCURACY_TOLERANCE;
+    std::cout << "accuracy difference: " << accuracy_difference << " (tolerance " << ACCURACY_TOLERANCE << ", "
+              << (within_tolerance ? "ok" : "FAILED") << ")" << std::endl;
+
+    //= bf16 model file round trip =
+    const std::string filename = "bf16_bench_model.bin";
+    mlp_bf16.save_model_binary(filename, WeightEncoding::DENSE_BF16);
+
+    MLP loaded({num_features, 128, num_classes}, Precision::BF16);
+    loaded.load_model_binary(filename);
+    std::remove(filename.c_str());
+
+    std::cout << "== bf16 model file ==" << std::endl;
+    std::cout << "loaded accuracy " << accuracy(loaded, X_test, y_test)
+              << ", max abs output difference " << max_abs_difference(mlp_bf16.predict(X_test), loaded.predict(X_test)) << std::endl;
+
+    return within_tolerance ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <random>
+#include "../src/mlp.hpp"
+#include "bench_util.hpp"
+
+//Compares convergence against wall-time for synchronous mini-batch training and Hogwild! training
+//on a synthetic wide, sparse classification dataset (one-hot style features). The 1-thread runs use
+//the same sparse kernels as Hogwild!, separating the kernel speedup from the gain of asynchrony
+
+//Build a dataset of 'num_samples' rows where only 'active' of 'num_features' columns are non-zero.
+//Each feature votes for a class, the label is the class with the most votes (one-hot encoded)
+void make_sparse_dataset(Matrix& inputs, Matrix& targets, int active, unsigned seed) {
+    std::mt19937 gen(seed);
+    int num_features = inputs.get_columns();
+    int num_classes  = targets.get_columns();
+
+    std::uniform_int_distribution<> feature_dis(0, num_features - 1);
+    std::vector<int> feature_class(num_features);
+    std::mt19937 class_gen(1234);
+    for (int& c : feature_class) c = class_gen() % num_classes;
+
+    for (int i = 0; i < inputs.get_rows(); i++) {
+        std::vector<int> votes(num_classes, 0);
+        for (int a = 0; a < active; a++) {
+            int f = feature_dis(gen);
+            inputs(i, f) = 1.0;
+            votes[feature_class[f]]++;
+        }
+        targets(i, std::max_element(votes.begin(), votes.end()) - votes.begin()) = 1.0;
+    }
+}
+
+//Mean squared error and classification accuracy over the whole set
+void evaluate(MLP& mlp, const Matrix& inputs, const Matrix& targets, double& mse, double& accuracy) {
+    Matrix predictions = mlp.predict(inputs);
+    mse = 0.0;
+    int correct = 0;
+
+    for (int i = 0; i < predictions.get_rows(); i++) {
+        for (int j = 0; j < predictions.get_columns(); j++) {
+            double diff = predictions(i, j) - targets(i, j);
+            mse += diff * diff;
+        }
+        if (argmax_row(predictions, i) == argmax_row(targets, i)) correct++;
+    }
+
+    mse /= predictions.get_rows() * predictions.get_columns();
+    accuracy = static_cast<double>(correct) / predictions.get_rows();
+}
+
+template <typename TrainStep>
+void run(const std::string& name, const std::vector<int>& layer_sizes, const Matrix& inputs, const Matrix& targets, int rounds, TrainStep step) {
+    MLP mlp(layer_sizes);
+    double train_seconds = 0.0;
+
+    std::cout << "== " << name << " ==" << std::endl;
+    std::cout << std::setw(8) << "epoch" << std::setw(12) << "time(s)" << std::setw(12) << "mse" << std::setw(12) << "accuracy" << std::endl;
+
+    for (int r = 1; r <= rounds; r++) {
+        train_seconds += time_per_call(1, [&]() { step(mlp); });
+
+        double mse, accuracy;
+        evaluate(mlp, inputs, targets, mse, accuracy);
+        std::cout << std::setw(8) << r << std::setw(12) << std::fixed << std::setprecision(4) << train_seconds
+                  << std::setw(12) << mse << std::setw(12) << accuracy << std::endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int num_samples  = 4000;
+    int num_features = 2048;
+    int num_classes  = 4;
+    int active       = 16;
+    int rounds       = 10;
+    int num_threads  = (argc > 1) ? std::stoi(argv[1]) : std::max(1u, std::thread::hardware_concurrency());
+
+    double learning_rate = 0.05;
+    std::vector<int> layer_sizes = {num_features, 64, num_classes};
+
+    Matrix inputs(num_samples, num_features);
+    Matrix targets(num_samples, num_classes);
+    make_sparse_dataset(inputs, targets, active, 42);
+
+    std::cout << num_samples << " samples, " << num_features << " features (" << active << " non-zero), "
+              << num_threads << " Hogwild! threads" << std::endl;
+
+    //Dense kernel baseline
+    run("Synchronous mini-batch, dense kernel (MLP::train, batch 32)", layer_sizes, inputs, targets, rounds, [&](MLP& mlp) {
+        mlp.train(inputs, targets, learning_rate, 1, 32);
+    });
+
+    //Same sparse kernels as Hogwild! but on one thread, so any further gain below comes from asynchrony alone
+    run("Synchronous mini-batch, sparse kernel (1 thread, batch 32)", layer_sizes, inputs, targets, rounds, [&](MLP& mlp) {
+        mlp.train_hogwild(inputs, targets, learning_rate, 1, 1, 32);
+    });
+
+    run("Sequential SGD, sparse kernel (1 thread, batch 1)", layer_sizes, inputs, targets, rounds, [&](MLP& mlp) {
+        mlp.train_hogwild(inputs, targets, learning_rate, 1, 1, 1);
+    });
+
+    run("Hogwild! (" + std::to_string(num_threads) + " threads, batch 1)", layer_sizes, inputs, targets, rounds, [&](MLP& mlp) {
+        mlp.train_hogwild(inputs, targets, learning_rate, 1, num_threads, 1);
+    });
+
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include <iostream>
+#include <iomanip>
+#include "../src/mlp.hpp"
+#include "../src/inference.hpp"
+#include "bench_util.hpp"
+
+//Compares MLP::predict against the compiled InferenceExecutor: per-call latency at several batch sizes,
+//on narrow and wide networks
+
+//Per-call latency of both paths at several batch sizes for one network
+void bench_network(const std::vector<int>& layer_sizes, int max_batch) {
+    MLP mlp(layer_sizes);
+    InferenceExecutor executor = InferenceExecutor::compile(mlp, max_batch);
+
+    std::cout << "Network ";
+    for (size_t l = 0; l < layer_sizes.size(); l++) std::cout << (l ? "-" : "") << layer_sizes[l];
+    std::cout << ", executor max batch " << max_batch << std::endl;
+    std::cout << std::setw(8) << "batch" << std::setw(16) << "predict(us)" << std::setw(16) << "executor(us)"
+              << std::setw(12) << "speedup" << std::setw(14) << "max diff" << std::endl;
+
+    for (int batch : {1, 8, 64}) {
+        Matrix input(batch, layer_sizes.front());
+        input.set_random_weights();
+
+        std::vector<double> in(batch * layer_sizes.front()), out(batch * layer_sizes.back());
+        for (int i = 0; i < batch; i++) {
+            for (int j = 0; j < layer_sizes.front(); j++) {
+                in[i * layer_sizes.front() + j] = input(i, j);
+            }
+        }
+
+        //Aim for roughly the same total work per measurement whatever the network size
+        long long macs = 0;
+        for (size_t l = 0; l + 1 < layer_sizes.size(); l++) macs += static_cast<long long>(layer_sizes[l]) * layer_sizes[l + 1];
+        int repeats = static_cast<int>(std::max(16LL, 200000000LL / (macs * batch)));
+
+        double predict_time  = time_per_call<std::micro>(repeats, [&]() { mlp.predict(input); });
+        double executor_time = time_per_call<std::micro>(repeats, [&]() { executor.run(in.data(), batch, out.data()); });
+
+        //Both paths must agree
+        double diff = max_abs_difference(mlp.predict(input), executor.predict(input));
+
+        std::cout << std::setw(8) << batch << std::setw(16) << std::fixed << std::setprecision(2) << predict_time
+                  << std::setw(16) << executor_time << std::setw(11) << std::setprecision(1) << predict_time / executor_time << "x"
+                  << std::setw(14) << std::scientific << std::setprecision(2) << diff << std::defaultfloat << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+int main() {
+    //Narrow networks (the XOR net of main.cpp, small tabular nets) down to a wide MNIST-sized one
+    bench_network({2, 10, 1}, 64);
+    bench_network({64, 8, 8, 1}, 64);
+    bench_network({784, 32, 10}, 64);
+    bench_network({256, 512, 512, 256, 10}, 64);
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdio>
+#include "../src/mlp.hpp"
+#include "../src/sparse.hpp"
+#include "bench_util.hpp"
+
+//Dense vs CSR/BSR inference at 50/80/95% sparsity, accuracy of a pruned + fine-tuned model and the model file
+//round trip of pruned layers. Exits with 1 if a reloaded model does not match the saved one
+
+int main() {
+    //= Kernels: batch x 1024 times 1024 x 1024 =
+    int batch = 32, size = 1024, block_size = 4;
+
+    Matrix input(batch, size), weights(size, size);
+    input.set_random_weights();
+    weights.set_random_weights();
+
+    double dense_time = time_per_call<std::milli>(3, [&]() { Matrix c = input * weights; });
+
+    std::cout << "== SpMM " << batch << "x" << size << " * " << size << "x" << size << " (dense " << std::fixed
+              << std::setprecision(2) << dense_time << " ms) ==" << std::endl;
+    std::cout << std::setw(10) << "sparsity" << std::setw(12) << "csr(ms)" << std::setw(12) << "bsr" << block_size << "(ms)"
+              << std::setw(14) << "csr speedup" << std::setw(14) << "bsr speedup" << std::endl;
+
+    for (double sparsity : {0.25, 0.5, 0.65, 0.8, 0.95}) {
+        PruneMask csr_mask = magnitude_prune_mask(weights, sparsity);
+        PruneMask bsr_mask = magnitude_prune_mask(weights, sparsity, block_size);
+        CSRMatrix csr = CSRMatrix::from_matrix(weights, csr_mask);
+        BSRMatrix bsr = BSRMatrix::from_matrix(weights, bsr_mask, block_size);
+
+        double csr_time = time_per_call<std::milli>(5, [&]() { Matrix c = csr.lhs_dot_product(input); });
+        double bsr_time = time_per_call<std::milli>(5, [&]() { Matrix c = bsr.lhs_dot_product(input); });
+
+        std::cout << std::setw(9) << sparsity * 100 << "%" << std::setw(12) << csr_time << std::setw(13) << bsr_time
+                  << std::setw(13) << dense_time / csr_time << "x" << std::setw(13) << dense_time / bsr_time << "x" << std::endl;
+    }
+
+    //= Pruning + fine-tuning =
+    int num_samples = 3000, num_features = 64, num_classes = 4, num_test = 600;
+    Matrix inputs(num_samples, num_features);
+    Matrix targets(num_samples, num_classes);
+    make_blob_dataset(inputs, targets, 7);
+
+    Matrix X_train = inputs.get_submatrix(0, num_samples - num_test);
+    Matrix y_train = targets.get_submatrix(0, num_samples - num_test);
+    Matrix X_test  = inputs.get_submatrix(num_samples - num_test, num_samples);
+    Matrix y_test  = targets.get_submatrix(num_samples - num_test, num_samples);
+
+    MLP trained({num_features, 256, num_classes});
+    trained.train(X_train, y_train, 0.05, 20, 16);
+
+    std::cout << "== Pruning (" << num_features << "-256-" << num_classes << ") ==" << std::endl;
+    std::cout << "dense accuracy " << std::setprecision(4) << accuracy(trained, X_test, y_test) << std::endl;
+    std::cout << std::setw(10) << "sparsity" << std::setw(8) << "block" << std::setw(12) << "pruned" << std::setw(12) << "fine-tuned" << std::endl;
+
+    for (double sparsity : {0.5, 0.8, 0.95}) {
+        for (int block : {1, block_size}) {
+            MLP pruned = trained;
+            pruned.prune(sparsity, block);
+            double pruned_accuracy = accuracy(pruned, X_test, y_test);
+
+            pruned.train(X_train, y_train, 0.05, 5, 16);
+            std::cout << std::setw(9) << std::setprecision(0) << sparsity * 100 << "%" << std::setw(8) << block
+                      << std::setw(12) << std::setprecision(4) << pruned_accuracy << std::setw(12) << accuracy(pruned, X_test, y_test) << std::endl;
+        }
+    }
+
+    //= Model file round trip =
+    //fp64 files must reload exactly, bf16 files within bf16 rounding. Layers at or above SPARSE_MIN_SPARSITY
+    //are stored as CSR/BSR and must come back pruned, the others are stored dense
+    const std::string filename = "sparse_bench_model.bin";
+    const double BF16_TOLERANCE = 1e-2;
+    bool round_trip_ok = true;
+
+    std::cout << "== Model file round trip ==" << std::endl;
+    std::cout << std::setw(10) << "sparsity" << std::setw(8) << "block" << std::setw(8) << "values"
+              << std::setw(10) << "bytes" << std::setw(10) << "sparse" << std::setw(14) << "max diff" << std::endl;
+
+    for (double sparsity : {0.5, 0.8, 0.95}) {
+        for (int block : {1, block_size}) {
+            for (WeightEncoding encoding : {WeightEncoding::DENSE_F64, WeightEncoding::DENSE_BF16}) {
+                MLP pruned = trained;
+                pruned.prune(sparsity, block);
+                pruned.save_model_binary(filename, encoding);
+
+                std::ifstream file(filename, std::ios::binary | std::ios::ate);
+                long long bytes = file.tellg();
+                file.close();
+
+                MLP loaded({num_features, 256, num_classes});
+                loaded.load_model_binary(filename);
+                std::remove(filename.c_str());
+
+                bool bf16 = (encoding == WeightEncoding::DENSE_BF16);
+                bool sparse = loaded.get_layers().front().is_pruned();
+                double diff = max_abs_difference(pruned.predict(X_test), loaded.predict(X_test));
+
+                bool ok = (sparse == (sparsity >= SPARSE_MIN_SPARSITY)) && (bf16 ? diff <= BF16_TOLERANCE : diff == 0.0);
+                round_trip_ok = round_trip_ok && ok;
+
+                std::cout << std::setw(9) << std::setprecision(0) << sparsity * 100 << "%" << std::setw(8) << block
+                          << std::setw(8) << (bf16 ? "bf16" : "fp64") << std::setw(10) << bytes << std::setw(10) << (sparse ? "yes" : "no")
+                          << std::setw(14) << std::scientific << std::setprecision(2) << diff << std::fixed
+                          << (ok ? "" : "  FAILED") << std::endl;
+            }
+        }
+    }
+
+    return round_trip_ok ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+#include "bf16.hpp"
+#include <stdexcept>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BF16_HAVE_X86 1
+#endif
+
+bool cpu_has_avx512_bf16() {
+#ifdef BF16_HAVE_X86
+    static const bool supported = __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bf16");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+BF16Weights BF16Weights::from_matrix(const Matrix& mat) {
+    BF16Weights result(mat.get_rows(), mat.get_columns());
+
+    for (int k = 0; k < mat.get_rows(); k++) {
+        for (int j = 0; j < mat.get_columns(); j++) {
+            result.set(k, j, mat(k, j));
+        }
+    }
+
+    return result;
+}
+
+BF16Matrix BF16Matrix::from_matrix(const Matrix& mat) {
+    BF16Matrix result(mat.get_rows(), mat.get_columns());
+
+    for (int i = 0; i < mat.get_rows(); i++) {
+        for (int j = 0; j < mat.get_columns(); j++) {
+            result(i, j) = float_to_bf16(static_cast<float>(mat(i, j)));
+        }
+    }
+
+    return result;
+}
+
+Matrix BF16Matrix::to_matrix() const {
+    Matrix result(rows, columns);
+
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < columns; j++) {
+            result(i, j) = get(i, j);
+        }
+    }
+
+    return result;
+}
+
+#ifdef BF16_HAVE_X86
+//AVX-512 BF16 kernel for one row of the input and BLOCKS x 16 output columns.
+//Each step broadcasts the input pair (k, k + 1) and vdpbf16ps multiplies it against rows k, k + 1 of 16 columns,
+//adding both products into 16 fp32 accumulators
+template <int BLOCKS>
+__attribute__((target("avx512f,avx512bf16")))
+static void dot_product_block_avx512(const uint16_t* a_row, int pairs, const uint16_t* w, int pair_stride, float* out) {
+    __m512 acc[BLOCKS];
+    for (int b = 0; b < BLOCKS; b++) acc[b] = _mm512_setzero_ps();
+
+    for (int p = 0; p < pairs; p++) {
+        uint32_t pair;
+        std::memcpy(&pair, a_row + 2 * p, sizeof(pair));
+        __m512bh x = (__m512bh)_mm512_set1_epi32(pair);
+
+        const uint16_t* w_row = w + static_cast<size_t>(p) * pair_stride;
+        for (int b = 0; b < BLOCKS; b++) {
+            acc[b] = _mm512_dpbf16_ps(acc[b], x, (__m512bh)_mm512_loadu_si512(w_row + 32 * b));
+        }
+    }
+
+    for (int b = 0; b < BLOCKS; b++) _mm512_storeu_ps(out + 16 * b, acc[b]);
+}
+
+__attribute__((target("avx512f,avx512bf16")))
+static void dot_product_avx512(const uint16_t* a, int rows, int a_stride, const BF16Weights& weights, float* result) {
+    const int cols  = weights.get_columns();
+    const int pairs = (weights.get_rows() + 1) / 2;
+    const int pair_stride = weights.get_pair_stride();
+    alignas(64) float tile[64];
+
+    for (int i = 0; i < rows; i++) {
+        const uint16_t* a_row = a + static_cast<size_t>(i) * a_stride;
+
+        //Up to four registers (64 columns) at a time
+        for (int j = 0; j < cols; j += 64) {
+            const uint16_t* w = weights.get_data() + 2 * j;
+            switch (std::min(4, (cols - j + 15) / 16)) {
+                case 4:  dot_product_block_avx512<4>(a_row, pairs, w, pair_stride, tile); break;
+                case 3:  dot_product_block_avx512<3>(a_row, pairs, w, pair_stride, tile); break;
+                case 2:  dot_product_block_avx512<2>(a_row, pairs, w, pair_stride, tile); break;
+                default: dot_product_block_avx512<1>(a_row, pairs, w, pair_stride, tile); break;
+            }
+            std::copy(tile, tile + std::min(64, cols - j), result + static_cast<size_t>(i) * cols + j);
+        }
+    }
+}
+#endif
+
+void BF16Matrix::dot_product(const BF16Weights& weights, std::vector<float>& result) const {
+    if (columns != weights.get_rows()) {
+        throw std::invalid_argument("[-] ERROR Bf16.cpp: Number of columns (mat1) is not the same as number of rows (mat2) for dot product");
+    }
+
+    const int cols = weights.get_columns();
+    result.assign(static_cast<size_t>(rows) * cols, 0.0f);
+
+#ifdef BF16_HAVE_X86
+    if (cpu_has_avx512_bf16()) {
+        dot_product_avx512(data.data(), rows, stride, weights, result.data());
+        return;
+    }
+#endif
+
+    //Conversion-based fallback: widen each bf16 operand to fp32 and accumulate in fp32 (i-k-j order)
+    for (int i = 0; i < rows; i++) {
+        float* out = result.data() + static_cast<size_t>(i) * cols;
+        for (int k = 0; k < columns; k++) {
+            float val = get(i, k);
+            if (val == 0.0f) continue;
+
+            for (int j = 0; j < cols; j++) {
+                out[j] += val * weights.get(k, j);
+            }
+        }
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef BF16_H
+#define BF16_H
+
+#include "matrix.hpp"
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+//Storage precision for a layer's weights and activations
+//BF16 stores activations as bf16 and runs the forward GEMM on a bf16 copy of the weights with fp32 accumulation.
+//The fp64 weights stay the master copy that backpropagation updates
+enum class Precision { FP64, BF16 };
+
+//Convert fp32 to bf16 (upper 16 bits of the fp32 pattern), rounding to nearest even
+inline uint16_t float_to_bf16(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+
+    //Keep NaNs quiet instead of letting the rounding carry turn them into infinity
+    if (std::isnan(value)) {
+        return static_cast<uint16_t>((bits >> 16) | 0x0040);
+    }
+
+    bits += 0x7FFF + ((bits >> 16) & 1);
+    return static_cast<uint16_t>(bits >> 16);
+}
+
+//Convert bf16 to fp32 (exact)
+inline float bf16_to_float(uint16_t value) {
+    uint32_t bits = static_cast<uint32_t>(value) << 16;
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+//True if the CPU supports the AVX-512 BF16 dot product instructions (checked once at runtime)
+bool cpu_has_avx512_bf16();
+
+//bf16 copy of a weight matrix in the pair-interleaved layout vdpbf16ps consumes: (k, j) and (k + 1, j) are adjacent,
+//so one 512-bit load holds rows k, k + 1 of 16 columns. Rows are padded to an even count and columns to a multiple
+//of 16 with zeros. Single entries can be rewritten in place, so the copy is kept in sync by the weight update itself
+class BF16Weights {
+private:
+    int rows, columns;
+
+    //Elements per pair of rows (2 x padded columns)
+    int pair_stride;
+
+    std::vector<uint16_t> data;
+
+    inline size_t index(int k, int j) const { return static_cast<size_t>(k / 2) * pair_stride + 2 * j + (k & 1); }
+
+public:
+    BF16Weights(int rows = 0, int columns = 0)
+        : rows(rows), columns(columns), pair_stride(2 * ((columns + 15) / 16 * 16)), data(static_cast<size_t>((rows + 1) / 2) * pair_stride, 0) {};
+
+    //Convert from a Matrix (fp64)
+    static BF16Weights from_matrix(const Matrix& mat);
+
+    //Get methods
+    int get_rows()        const { return rows; }
+    int get_columns()     const { return columns; }
+    int get_pair_stride() const { return pair_stride; }
+    const uint16_t* get_data() const { return data.data(); }
+
+    //Read/write a single weight
+    float get(int k, int j) const            { return bf16_to_float(data[index(k, j)]); }
+    void  set(int k, int j, double value)    { data[index(k, j)] = float_to_bf16(static_cast<float>(value)); }
+};
+
+//Row-major bf16 matrix, used for activations
+class BF16Matrix {
+private:
+    int rows, columns;
+
+    //Row stride, padded to an even number of zero-filled elements so the kernel can load (k, k + 1) pairs
+    int stride;
+
+    //One-dimensional vector, treated as 2D
+    std::vector<uint16_t> data;
+
+public:
+    BF16Matrix(int rows = 0, int columns = 0)
+        : rows(rows), columns(columns), stride((columns + 1) / 2 * 2), data(static_cast<size_t>(rows) * stride, 0) {};
+
+    //Convert from a Matrix (fp64)
+    static BF16Matrix from_matrix(const Matrix& mat);
+
+    //Get methods
+    int get_rows()    const { return rows; }
+    int get_columns() const { return columns; }
+
+    //Raw bf16 value access
+    uint16_t&       operator()(int i, int j)       { return data[static_cast<size_t>(i) * stride + j]; }
+    const uint16_t& operator()(int i, int j) const { return data[static_cast<size_t>(i) * stride + j]; }
+
+    //Value widened to fp32
+    float get(int i, int j) const { return bf16_to_float((*this)(i, j)); }
+
+    //Convert back to a Matrix (fp64)
+    Matrix to_matrix() const;
+
+    //Dot product against bf16 weights, accumulated in fp32 (AVX-512 BF16 when available)
+    //'result' is resized to rows x weights columns, row-major
+    void dot_product(const BF16Weights& weights, std::vector<float>& result) const;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#include "inference.hpp"
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+InferenceExecutor::InferenceExecutor(std::shared_ptr<const std::vector<PackedLayer>> layers, int max_batch, int widest)
+    : layers(std::move(layers)), max_batch(max_batch), widest(widest), arena(2 * static_cast<size_t>(max_batch) * widest, 0.0) {}
+
+InferenceExecutor InferenceExecutor::compile(const MLP& mlp, int max_batch) {
+    if (max_batch <= 0) {
+        throw std::invalid_argument("[-] ERROR Inference.cpp: max_batch must be positive");
+    }
+
+    auto packed = std::make_shared<std::vector<PackedLayer>>();
+    int widest = 0;
+
+    const std::vector<Layer>& mlp_layers = mlp.get_layers();
+    for (size_t l = 0; l < mlp_layers.size(); l++) {
+        const Matrix& weights = mlp_layers[l].get_weights();
+        int rows = weights.get_rows(), cols = weights.get_columns();
+        int num_panels = (cols + PANEL_WIDTH - 1) / PANEL_WIDTH;
+
+        PackedLayer layer{rows, cols, std::vector<double>(static_cast<size_t>(num_panels) * rows * PANEL_WIDTH, 0.0)};
+        for (int p = 0; p < num_panels; p++) {
+            double* panel = layer.panels.data() + static_cast<size_t>(p) * rows * PANEL_WIDTH;
+            for (int k = 0; k < rows; k++) {
+                for (int c = 0; c < PANEL_WIDTH && p * PANEL_WIDTH + c < cols; c++) {
+                    panel[k * PANEL_WIDTH + c] = weights(k, p * PANEL_WIDTH + c);
+                }
+            }
+        }
+
+        //Only hidden activations go through the arena, the last layer writes straight to the caller's output
+        if (l + 1 < mlp_layers.size()) {
+            widest = std::max(widest, cols);
+        }
+        packed->push_back(std::move(layer));
+    }
+
+    if (packed->empty()) {
+        throw std::invalid_argument("[-] ERROR Inference.cpp: Cannot compile an MLP without layers");
+    }
+
+    return InferenceExecutor(packed, max_batch, widest);
+}
+
+int InferenceExecutor::get_input_size() const {
+    return layers->front().inputs;
+}
+
+int InferenceExecutor::get_output_size() const {
+    return layers->back().outputs;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INFERENCE_HAVE_X86 1
+#endif
+
+//SIMD vectors of doubles (GCC vector extensions), compiled to xmm or ymm registers by the calling function's target
+typedef double Vec2 __attribute__((vector_size(16)));
+typedef double Vec4 __attribute__((vector_size(32)));
+
+//Unaligned load (out parameter rather than a return value, which would be an ABI change for Vec4 in baseline code)
+template <typename V>
+__attribute__((always_inline)) inline void load_vec(V& v, const double* ptr) {
+    std::memcpy(&v, ptr, sizeof(V));
+}
+
+//ROWS x (VECS vectors) register tile of the fused kernel over weight rows [k0, k1) (K blocking). Sizes are chosen
+//by the callers so that the accumulators fit the register file. The first K block starts from zero, later ones
+//from the partial sums left in 'output', and the last one applies the sigmoid. Only 'cols' columns are stored;
+//the columns past them read the panel's zero padding
+template <typename V, int ROWS, int VECS>
+__attribute__((always_inline))
+inline void run_tile(const double* panel, const double* input, int K, int k0, int k1, double* output, int N, int cols) {
+    constexpr int STRIDE = InferenceExecutor::PANEL_WIDTH;
+    constexpr int LANES  = sizeof(V) / sizeof(double);
+    constexpr int W      = VECS * LANES;
+    //Small tiles have too few accumulators to hide the add latency, so they keep SPLIT independent
+    //partial sums over interleaved k and add them up at the end
+    constexpr int SPLIT = (ROWS * VECS <= 2) ? 2 : 1;
+
+    double tile[ROWS][W] = {};
+    if (k0 > 0) {
+        for (int r = 0; r < ROWS; r++) {
+            for (int c = 0; c < cols; c++) {
+                tile[r][c] = output[static_cast<size_t>(r) * N + c];
+            }
+        }
+    }
+
+    V acc[SPLIT][ROWS][VECS];
+    for (int s = 0; s < SPLIT; s++) {
+        for (int r = 0; r < ROWS; r++) {
+            for (int v = 0; v < VECS; v++) {
+                acc[s][r][v] = V{};
+                if (s == 0) load_vec(acc[s][r][v], &tile[r][v * LANES]);
+            }
+        }
+    }
+
+    int k = k0;
+    for (; k + SPLIT <= k1; k += SPLIT) {
+        for (int s = 0; s < SPLIT; s++) {
+            V w[VECS];
+            for (int v = 0; v < VECS; v++) load_vec(w[v], panel + (k + s) * STRIDE + v * LANES);
+
+            for (int r = 0; r < ROWS; r++) {
+                const V x = V{} + input[static_cast<size_t>(r) * K + k + s];
+                for (int v = 0; v < VECS; v++) acc[s][r][v] += x * w[v];
+            }
+        }
+    }
+    for (; k < k1; k++) {
+        V w[VECS];
+        for (int v = 0; v < VECS; v++) load_vec(w[v], panel + k * STRIDE + v * LANES);
+
+        for (int r = 0; r < ROWS; r++) {
+            const V x = V{} + input[static_cast<size_t>(r) * K + k];
+            for (int v = 0; v < VECS; v++) acc[0][r][v] += x * w[v];
+        }
+    }
+
+    for (int r = 0; r < ROWS; r++) {
+        for (int v = 0; v < VECS; v++) {
+            for (int s = 1; s < SPLIT; s++) acc[0][r][v] += acc[s][r][v];
+            std::memcpy(&tile[r][v * LANES], &acc[0][r][v], sizeof(V));
+        }
+    }
+
+    for (int r = 0; r < ROWS; r++) {
+        for (int c = 0; c < cols; c++) {
+            output[static_cast<size_t>(r) * N + c] = (k1 == K) ? 1.0 / (1.0 + std::exp(-tile[r][c])) : tile[r][c];
+        }
+    }
+}
+
+template <typename V, int VECS>
+__attribute__((always_inline))
+inline void run_tile_rows(int rows, const double* panel, const double* input, int K, int k0, int k1, double* output, int N, int cols) {
+    switch (rows) {
+        case 4:  run_tile<V, 4, VECS>(panel, input, K, k0, k1, output, N, cols); break;
+        case 3:  run_tile<V, 3, VECS>(panel, input, K, k0, k1, output, N, cols); break;
+        case 2:  run_tile<V, 2, VECS>(panel, input, K, k0, k1, output, N, cols); break;
+        default: run_tile<V, 1, VECS>(panel, input, K, k0, k1, output, N, cols); break;
+    }
+}
+
+//Layer loop with ROW_BLOCK x (2 vectors) tiles. The last tile of a narrow layer (a single output, say) drops to
+//one vector. K is processed in blocks of K_BLOCK rows so the panel slice stays in L1 across all row blocks
+template <typename V>
+__attribute__((always_inline))
+inline void run_layer_tiles(const double* panels, int K, int N, const double* input, int batch, double* output) {
+    constexpr int PANEL_WIDTH = InferenceExecutor::PANEL_WIDTH;
+    constexpr int ROW_BLOCK   = InferenceExecutor::ROW_BLOCK;
+    constexpr int K_BLOCK     = InferenceExecutor::K_BLOCK;
+    constexpr int LANES       = sizeof(V) / sizeof(double);
+    constexpr int TILE_WIDTH  = 2 * LANES;
+
+    for (int k0 = 0; k0 < K; k0 += K_BLOCK) {
+        const int k1 = std::min(K, k0 + K_BLOCK);
+
+        for (int j = 0; j < N; j += TILE_WIDTH) {
+            const double* panel = panels + static_cast<size_t>(j / PANEL_WIDTH) * K * PANEL_WIDTH + j % PANEL_WIDTH;
+            const int cols = std::min(TILE_WIDTH, N - j);
+
+            for (int r0 = 0; r0 < batch; r0 += ROW_BLOCK) {
+                const int rows = std::min(ROW_BLOCK, batch - r0);
+                const double* in = input + static_cast<size_t>(r0) * K;
+                double* out = output + static_cast<size_t>(r0) * N + j;
+
+                if (cols > LANES) run_tile_rows<V, 2>(rows, panel, in, K, k0, k1, out, N, cols);
+                else              run_tile_rows<V, 1>(rows, panel, in, K, k0, k1, out, N, cols);
+            }
+        }
+    }
+}
+
+#ifdef INFERENCE_HAVE_X86
+//AVX2: 4 x 8 tiles, 8 ymm accumulators
+__attribute__((target("avx2")))
+static void run_layer_avx2(const double* panels, int K, int N, const double* input, int batch, double* output) {
+    run_layer_tiles<Vec4>(panels, K, N, input, batch, output);
+}
+
+static bool cpu_has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#endif
+
+void InferenceExecutor::run_layer(const PackedLayer& layer, const double* input, int batch, double* output) {
+#ifdef INFERENCE_HAVE_X86
+    if (cpu_has_avx2()) {
+        run_layer_avx2(layer.panels.data(), layer.inputs, layer.outputs, input, batch, output);
+        return;
+    }
+#endif
+
+    //Baseline (SSE2, 16 xmm registers): 4 x 4 tiles, 8 xmm accumulators. A 4 x 8 tile would need all 16 and spill
+    run_layer_tiles<Vec2>(layer.panels.data(), layer.inputs, layer.outputs, input, batch, output);
+}
+
+void InferenceExecutor::run(const double* input, int batch, double* output) {
+    const std::vector<PackedLayer>& packed = *layers;
+    const int in_size = get_input_size(), out_size = get_output_size();
+
+    double* ping = arena.data();
+    double* pong = arena.data() + static_cast<size_t>(max_batch) * widest;
+
+    for (int start = 0; start < batch; start += max_batch) {
+        const int rows = std::min(max_batch, batch - start);
+        const double* src = input + static_cast<size_t>(start) * in_size;
+
+        for (size_t l = 0; l < packed.size(); l++) {
+            double* dst = (l + 1 == packed.size()) ? output + static_cast<size_t>(start) * out_size : ping;
+            run_layer(packed[l], src, rows, dst);
+
+            src = dst;
+            std::swap(ping, pong);
+        }
+    }
+}
+
+Matrix InferenceExecutor::predict(const Matrix& input) {
+    if (input.get_columns() != get_input_size()) {
+        throw std::invalid_argument("[-] ERROR Inference.cpp: Input columns do not match the network input size");
+    }
+
+    int batch = input.get_rows(), in_size = get_input_size(), out_size = get_output_size();
+    std::vector<double> in(static_cast<size_t>(batch) * in_size), out(static_cast<size_t>(batch) * out_size);
+
+    for (int i = 0; i < batch; i++) {
+        for (int j = 0; j < in_size; j++) {
+            in[static_cast<size_t>(i) * in_size + j] = input(i, j);
+        }
+    }
+
+    run(in.data(), batch, out.data());
+
+    Matrix result(batch, out_size);
+    for (int i = 0; i < batch; i++) {
+        for (int j = 0; j < out_size; j++) {
+            result(i, j) = out[static_cast<size_t>(i) * out_size + j];
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,64 @@
+#ifndef INFERENCE_H
+#define INFERENCE_H
+
+#include "matrix.hpp"
+#include "mlp.hpp"
+#include <vector>
+#include <memory>
+
+//Compiled, inference-only form of an MLP for low-latency serving
+//compile() plans everything once: weights are pre-packed into column panels for the GEMM kernel, the
+//GEMM and sigmoid of each layer are fused into one pass, and activations live in a static arena of two
+//ping-pong buffers sized to the widest hidden layer at the chosen max batch size. run() never allocates.
+//
+//The packed weights are immutable and shared between copies. run() and predict() write the object's own
+//arena, which is why they are non-const: give every thread its own copy of the executor (copying is cheap)
+class InferenceExecutor {
+public:
+    //Number of weight columns packed together. The kernel's register tile is 4 (SSE2) or 8 (AVX2, picked at
+    //runtime) of them, and a layer's last tile only as wide as its live columns
+    static constexpr int PANEL_WIDTH = 8;
+    //Number of input rows processed together by the kernel
+    static constexpr int ROW_BLOCK   = 4;
+    //Number of weight rows (inputs) processed per pass over the batch, so a panel slice stays in L1
+    static constexpr int K_BLOCK     = 256;
+
+    //Plan an executor for 'mlp' that processes up to 'max_batch' rows per pass
+    //Every layer is packed dense in fp64: pruned layers run with their zeros, not with the sparse kernels
+    static InferenceExecutor compile(const MLP& mlp, int max_batch);
+
+    //Run 'batch' rows of 'input' (row-major, batch x input size) into 'output' (row-major, batch x output size)
+    //Batches larger than max_batch are processed in chunks
+    void run(const double* input, int batch, double* output);
+
+    //Run the rows of a matrix, returns matrix
+    Matrix predict(const Matrix& input);
+
+    //Get methods
+    int get_input_size()  const;
+    int get_output_size() const;
+    int get_max_batch()   const { return max_batch; }
+
+private:
+    struct PackedLayer {
+        int inputs, outputs;
+
+        //Panel p holds columns [p * PANEL_WIDTH, (p + 1) * PANEL_WIDTH) of the weights as 'inputs' rows
+        //of PANEL_WIDTH contiguous values, zero padded past the last column
+        std::vector<double> panels;
+    };
+
+    std::shared_ptr<const std::vector<PackedLayer>> layers;
+    int max_batch;
+    int widest; //Widest hidden activation, in columns
+
+    //Two ping-pong activation buffers, each max_batch x widest
+    std::vector<double> arena;
+
+    InferenceExecutor(std::shared_ptr<const std::vector<PackedLayer>> layers, int max_batch, int widest);
+
+    //Fused GEMM + sigmoid for one layer: output = sigmoid(input * weights)
+    static void run_layer(const PackedLayer& layer, const double* input, int batch, double* output);
+};
+
+#endif
@@ -2,26 +2,54 @@
 #define LAYER_H
 
 #include "matrix.hpp"
+#include "bf16.hpp"
+#include "sparse.hpp"
 #include <vector>
 #include <cmath>
+#include <atomic>
 
 class Layer {
 private:
     Matrix weights; //Weights matrix for this layer
-    Matrix outputs; //Outputs from this layer
-    Matrix inputs;  //Inputs to this layer
+    Matrix outputs; //Outputs from this layer (FP64 precision)
+    Matrix inputs;  //Inputs to this layer (FP64 precision)
+
+    //Mixed precision (BF16). Only the activations of the current precision are kept, the others stay empty
+    Precision   precision;
+    BF16Matrix  outputs_bf16;  //Outputs from this layer
+    BF16Matrix  inputs_bf16;   //Inputs to this layer
+    BF16Weights weights_bf16;  //bf16 copy of the fp64 master weights, rewritten by every update
+
+    //Pruning
+    enum class SparseFormat { NONE, CSR, BSR };
+
+    PruneMask    mask;             //Pruning mask (one byte per weight), empty if the layer is not pruned
+    int          prune_block_size; //Block size the mask was built with, 1 for element-wise pruning
+    SparseFormat sparse_format;    //Sparse copy of the pruned weights used by forward(), NONE runs dense (always in BF16)
+    CSRMatrix    weights_csr;
+    BSRMatrix    weights_bsr;
+    bool         sparse_stale;     //Set whenever the weights change, forward() runs dense until refresh_sparse()
 
 public:
-    Layer(int input_size, int output_size) 
-        : weights(input_size, output_size), outputs(output_size, 1), inputs(input_size, 1) {
+    Layer(int input_size, int output_size, Precision precision = Precision::FP64) 
+        : weights(input_size, output_size), outputs(output_size, 1), inputs(input_size, 1),
+          precision(Precision::FP64),
+          prune_block_size(1), sparse_format(SparseFormat::NONE), sparse_stale(false) {
         //Initialize weights randomly
         weights.set_random_weights();
+        set_precision(precision);
     }
 
+    //Outputs in FP64 precision (empty in BF16, see get_outputs_bf16())
     const Matrix& get_outputs() const {
         return outputs;
     }
 
+    //Outputs in BF16 precision (empty in FP64)
+    const BF16Matrix& get_outputs_bf16() const {
+        return outputs_bf16;
+    }
+
     const Matrix& get_weights() const {
         return weights;
     }
@@ -31,16 +59,118 @@ public:
             throw std::invalid_argument("[-] ERROR: New weights dimensions do not match existing weights.");
         }
         weights = new_weights;
+        apply_mask();
+        sync_bf16_weights();
+        sparse_stale = true;
+    }
+
+    Precision get_precision() const {
+        return precision;
+    }
+
+    //Switch precision, releasing the activations (and bf16 weights) the other precision used
+    void set_precision(Precision new_precision) {
+        precision = new_precision;
+        if (precision == Precision::BF16) {
+            inputs  = Matrix(0, 0);
+            outputs = Matrix(0, 0);
+        }
+        else {
+            inputs_bf16  = BF16Matrix();
+            outputs_bf16 = BF16Matrix();
+        }
+        sync_bf16_weights();
+        if (is_pruned()) refresh_sparse();
+    }
+
+    //Magnitude pruning, see magnitude_prune_mask()
+    void prune(double sparsity, int block_size = 1) {
+        set_mask(magnitude_prune_mask(weights, sparsity, block_size), block_size);
+    }
+
+    //Prune with an explicit mask. Pruned weights are zeroed and stay zero through later training
+    void set_mask(const PruneMask& new_mask, int block_size = 1) {
+        if (new_mask.size() != static_cast<size_t>(weights.get_rows()) * weights.get_columns()) {
+            throw std::invalid_argument("[-] ERROR: Mask dimensions do not match existing weights.");
+        }
+        mask = new_mask;
+        prune_block_size = block_size;
+        apply_mask();
+        sync_bf16_weights();
+        refresh_sparse();
+    }
+
+    bool is_pruned() const {
+        return !mask.empty();
+    }
+
+    const PruneMask& get_mask() const {
+        return mask;
+    }
+
+    int get_prune_block_size() const {
+        return prune_block_size;
+    }
+
+    //True if forward() currently runs the sparse kernels
+    bool uses_sparse() const {
+        return sparse_format != SparseFormat::NONE && !sparse_stale;
+    }
+
+    //Rebuild the sparse weights after they changed (MLP::train calls this once training finishes).
+    //Layers pruned below SPARSE_MIN_SPARSITY stay dense, where the sparse kernels are slower. BF16 layers always
+    //run the dense bf16 kernel, so no sparse copy is kept for them
+    void refresh_sparse() {
+        sparse_stale  = false;
+        sparse_format = SparseFormat::NONE;
+        weights_csr   = CSRMatrix();
+        weights_bsr   = BSRMatrix();
+        if (!is_pruned() || precision == Precision::BF16 || mask_sparsity(mask) < SPARSE_MIN_SPARSITY) return;
+
+        if (prune_block_size > 1) {
+            weights_bsr   = BSRMatrix::from_matrix(weights, mask, prune_block_size);
+            sparse_format = SparseFormat::BSR;
+        }
+        else {
+            weights_csr   = CSRMatrix::from_matrix(weights, mask);
+            sparse_format = SparseFormat::CSR;
+        }
     }
 
     void forward(const Matrix& input) {
+        if (precision == Precision::BF16) {
+            forward(BF16Matrix::from_matrix(input));
+            return;
+        }
+
         inputs = input;
-        Matrix net_input = inputs * weights;
+        Matrix net_input = multiply_weights(inputs);
         sigmoid(net_input);
         outputs = net_input;
     }
 
+    //Mixed precision forward pass: bf16 inputs and weights, fp32 accumulation, bf16 outputs
+    void forward(const BF16Matrix& input) {
+        inputs_bf16 = input;
+
+        std::vector<float> net_input;
+        inputs_bf16.dot_product(weights_bf16, net_input);
+
+        outputs_bf16 = BF16Matrix(input.get_rows(), weights.get_columns());
+        for (int i = 0; i < outputs_bf16.get_rows(); i++) {
+            for (int j = 0; j < outputs_bf16.get_columns(); j++) {
+                float net = net_input[static_cast<size_t>(i) * outputs_bf16.get_columns() + j];
+                outputs_bf16(i, j) = float_to_bf16(1.0f / (1.0f + std::exp(-net)));
+            }
+        }
+    }
+
     void backward(const Matrix& error, double learning_rate) {
+        if (precision == Precision::BF16) {
+            backward_bf16(error, learning_rate);
+            return;
+        }
+
         //Sigmoid derivative
         Matrix sig_derivative(outputs.get_rows(), outputs.get_columns());
         for (int i = 0; i < outputs.get_rows(); i++) {
@@ -56,10 +186,166 @@ public:
                 weights(i, j) -= learning_rate * delta_weights(i, j);
             }
         }
+        apply_mask();
+        sparse_stale = true;
+    }
+
+    //Forward pass into an external activation buffer. The layer's own inputs/outputs are left
+    //untouched, so many threads can share one layer (see MLP::train_hogwild).
+    //Weights are read with relaxed atomic loads since other threads may be updating them
+    void forward(const Matrix& input, Matrix& output) const {
+        output = Matrix(input.get_rows(), weights.get_columns());
+
+        //i-k-j loop that skips zero input features, so wide and mostly-zero inputs (one-hot columns, flattened
+        //pixels) only touch the weight rows of their non-zero features
+        for (int i = 0; i < input.get_rows(); i++) {
+            for (int k = 0; k < input.get_columns(); k++) {
+                double val = input(i, k);
+                if (val == 0.0) continue;
+
+                for (int j = 0; j < weights.get_columns(); j++) {
+                    output(i, j) += val * load_relaxed(weights(k, j));
+                }
+            }
+        }
+        sigmoid(output);
+    }
+
+    //Error for the previous layer, error * weights.transpose(), read with relaxed atomic loads (see forward() above)
+    Matrix propagate_error(const Matrix& error) const {
+        Matrix result(error.get_rows(), weights.get_rows());
+
+        for (int i = 0; i < error.get_rows(); i++) {
+            for (int k = 0; k < weights.get_rows(); k++) {
+                double sum = 0.0;
+                for (int j = 0; j < weights.get_columns(); j++) {
+                    sum += error(i, j) * load_relaxed(weights(k, j));
+                }
+                result(i, k) = sum;
+            }
+        }
+
+        return result;
+    }
+
+    //Lock-free (Hogwild!) backward pass from external activation buffers. Each weight is updated with a relaxed
+    //atomic load and store rather than a lock or compare-and-swap: an update racing with another thread's may be
+    //lost, which Hogwild! tolerates, but there is no data race. Only the rows of non-zero input features are touched.
+    //Cached copies of the weights are not refreshed here, call weights_changed() once the threads have joined
+    void backward(const Matrix& input, const Matrix& output, const Matrix& error, double learning_rate) {
+        //Sigmoid derivative
+        Matrix sig_derivative(output.get_rows(), output.get_columns());
+        for (int i = 0; i < output.get_rows(); i++) {
+            for (int j = 0; j < output.get_columns(); j++) {
+                sig_derivative(i, j) = error(i, j) * output(i, j) * (1 - output(i, j));
+            }
+        }
+
+        //Update weights, equivalent to input.transpose() * sig_derivative with zero features skipped
+        for (int i = 0; i < input.get_rows(); i++) {
+            for (int k = 0; k < input.get_columns(); k++) {
+                double val = input(i, k);
+                if (val == 0.0) continue;
+
+                for (int j = 0; j < weights.get_columns(); j++) {
+                    //Pruned weights stay zero
+                    if (!is_kept(k, j)) continue;
+                    store_relaxed(weights(k, j), load_relaxed(weights(k, j)) - learning_rate * val * sig_derivative(i, j));
+                }
+            }
+        }
+    }
+
+    //Refresh the bf16 copy and invalidate the sparse copy of the weights after they were updated through backward(input, ...)
+    void weights_changed() {
+        sync_bf16_weights();
+        sparse_stale = true;
     }
 
 private:
-    void sigmoid(Matrix& mat) {
+    //Relaxed atomic access to weights shared between Hogwild! threads. Plain concurrent reads and writes of the
+    //same double would be undefined behaviour; relaxed atomics compile to ordinary loads and stores on x86
+    static double load_relaxed(const double& value) {
+        return std::atomic_ref<double>(const_cast<double&>(value)).load(std::memory_order_relaxed);
+    }
+
+    static void store_relaxed(double& target, double value) {
+        std::atomic_ref<double>(target).store(value, std::memory_order_relaxed);
+    }
+
+    //input * weights, with the sparse kernels when the layer is pruned enough
+    Matrix multiply_weights(const Matrix& input) const {
+        if (uses_sparse()) {
+            return (sparse_format == SparseFormat::BSR) ? weights_bsr.lhs_dot_product(input) : weights_csr.lhs_dot_product(input);
+        }
+        return input * weights;
+    }
+
+    //Rebuild the bf16 copy of the weights from the master weights (BF16), or release it (FP64)
+    void sync_bf16_weights() {
+        weights_bf16 = (precision == Precision::BF16) ? BF16Weights::from_matrix(weights) : BF16Weights();
+    }
+
+    //False if weight (k, j) is pruned
+    bool is_kept(int k, int j) const {
+        return !is_pruned() || mask[static_cast<size_t>(k) * weights.get_columns() + j];
+    }
+
+    //Zero the pruned weights
+    void apply_mask() {
+        if (!is_pruned()) return;
+
+        for (int i = 0; i < weights.get_rows(); i++) {
+            for (int j = 0; j < weights.get_columns(); j++) {
+                if (!is_kept(i, j)) weights(i, j) = 0.0;
+            }
+        }
+    }
+
+    //Mixed precision backward pass straight from the bf16 activations (no fp64 copy of them is made).
+    //The fp64 master weights are updated in i-k-j order, skipping zero inputs; while handling the last row of
+    //the batch each weight row is masked and written back to the bf16 copy as soon as its update is complete
+    void backward_bf16(const Matrix& error, double learning_rate) {
+        const int batch = outputs_bf16.get_rows(), cols = weights.get_columns();
+
+        //Sigmoid derivative
+        Matrix sig_derivative(batch, cols);
+        for (int i = 0; i < batch; i++) {
+            for (int j = 0; j < cols; j++) {
+                double out = outputs_bf16.get(i, j);
+                sig_derivative(i, j) = error(i, j) * out * (1 - out);
+            }
+        }
+
+        //Update weights, weights -= learning_rate * inputs.transpose() * sig_derivative
+        for (int i = 0; i < batch; i++) {
+            const double* delta = &sig_derivative(i, 0);
+            const bool last = (i == batch - 1);
+
+            for (int k = 0; k < weights.get_rows(); k++) {
+                double* row = &weights(k, 0);
+                double val = inputs_bf16.get(i, k);
+
+                if (val != 0.0) {
+                    double scale = learning_rate * val;
+                    for (int j = 0; j < cols; j++) {
+                        row[j] -= scale * delta[j];
+                    }
+                }
+
+                if (last) {
+                    for (int j = 0; j < cols; j++) {
+                        //Pruned weights stay zero
+                        if (!is_kept(k, j)) row[j] = 0.0;
+                        weights_bf16.set(k, j, row[j]);
+                    }
+                }
+            }
+        }
+        sparse_stale = true;
+    }
+
+    static void sigmoid(Matrix& mat) {
         for (int i = 0; i < mat.get_rows(); i++) {
             for (int j = 0; j < mat.get_columns(); j++) {
                 mat(i, j) = 1.0 / (1.0 + exp(-mat(i, j)));
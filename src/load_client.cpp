@@ -0,0 +1,158 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <random>
+#include <chrono>
+#include "mlp.hpp"
+#include "server_protocol.hpp"
+
+//Load generator for the inference server
+//Opens several connections that each send requests back to back with random inputs, then reports the
+//client side throughput and p50/p99 latency followed by the server's own counters.
+//--make-model writes a random model file to serve when no trained model is at hand
+
+using Clock = std::chrono::steady_clock;
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name << " [--port N | --unix PATH] [--connections N] [--requests N]" << std::endl
+              << "       " << name << " --make-model FILE [layer sizes, default 256 512 512 10]" << std::endl;
+}
+
+//Send a request with no payload and read back the text (STATS) response
+std::string request_stats(int fd) {
+    uint32_t status, length;
+    if (!write_u32(fd, REQUEST_STATS) || !read_u32(fd, status) || !read_u32(fd, length)) {
+        throw std::runtime_error("[-] ERROR: Connection to server lost");
+    }
+
+    std::string text(length, '\0');
+    if (!read_full(fd, &text[0], length)) {
+        throw std::runtime_error("[-] ERROR: Connection to server lost");
+    }
+    return text;
+}
+
+int main(int argc, char* argv[]) {
+    std::string unix_path;
+    int port        = DEFAULT_SERVER_PORT;
+    int connections = 16;
+    int requests    = 2000;
+
+    if (argc >= 3 && std::string(argv[1]) == "--make-model") {
+        std::vector<int> layer_sizes;
+        for (int i = 3; i < argc; i++) layer_sizes.push_back(std::stoi(argv[i]));
+        if (layer_sizes.size() < 2) layer_sizes = {256, 512, 512, 10};
+
+        MLP mlp(layer_sizes);
+        mlp.save_model_binary(argv[2]);
+        std::cout << "[+] Wrote random model to '" << argv[2] << "'" << std::endl;
+        return 0;
+    }
+
+    //Every flag takes a value; a missing or non-numeric one prints the usage
+    try {
+        for (int i = 1; i < argc; i += 2) {
+            if (i + 1 >= argc) throw std::invalid_argument(argv[i]);
+
+            std::string flag = argv[i], value = argv[i + 1];
+            if      (flag == "--port")        port        = std::stoi(value);
+            else if (flag == "--unix")        unix_path   = value;
+            else if (flag == "--connections") connections = std::stoi(value);
+            else if (flag == "--requests")    requests    = std::stoi(value);
+            else throw std::invalid_argument(flag);
+        }
+    }
+    catch (const std::exception&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        //Ask the server for the model's input size
+        int info_fd = connect_to_server(unix_path, port);
+        uint32_t status, input_size, output_size;
+        if (!write_u32(info_fd, REQUEST_INFO) || !read_u32(info_fd, status) || !read_u32(info_fd, input_size) || !read_u32(info_fd, output_size) || status != STATUS_OK) {
+            throw std::runtime_error("[-] ERROR: Connection to server lost");
+        }
+
+        std::cout << "[+] " << connections << " connections x " << requests << " requests, model "
+                  << input_size << " -> " << output_size << std::endl;
+
+        std::mutex latency_mutex;
+        std::vector<double> latencies;
+        int failures = 0;
+
+        auto start = Clock::now();
+        std::vector<std::thread> clients;
+        for (int c = 0; c < connections; c++) {
+            clients.emplace_back([&, c]() {
+                std::vector<double> local_latencies;
+                std::vector<double> input(input_size), output(output_size);
+                std::mt19937 gen(c);
+                std::uniform_real_distribution<> dis(0.0, 1.0);
+                int local_failures = 0;
+
+                try {
+                    int fd = connect_to_server(unix_path, port);
+                    for (int r = 0; r < requests; r++) {
+                        for (double& val : input) val = dis(gen);
+
+                        auto sent = Clock::now();
+                        uint32_t status = 0, length = 0;
+                        bool ok = write_u32(fd, REQUEST_INFER) && write_u32(fd, input_size) &&
+                                  write_full(fd, input.data(), input.size() * sizeof(double)) &&
+                                  read_u32(fd, status) && read_u32(fd, length);
+
+                        //Status and length are only valid once the header was read. Error responses carry a
+                        //message instead of outputs, a successful one must hold exactly output_size values
+                        ok = ok && (status != STATUS_OK || length == static_cast<uint32_t>(output_size));
+                        if (ok) {
+                            std::vector<char> payload(status == STATUS_OK ? length * sizeof(double) : length);
+                            ok = read_full(fd, payload.data(), payload.size());
+                        }
+                        if (!ok) {
+                            local_failures += requests - r;
+                            break;
+                        }
+                        if (status != STATUS_OK) {
+                            local_failures++;
+                            continue;
+                        }
+
+                        local_latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - sent).count());
+                    }
+                    ::close(fd);
+                }
+                catch (const std::exception&) {
+                    local_failures = requests;
+                }
+
+                std::lock_guard<std::mutex> lock(latency_mutex);
+                latencies.insert(latencies.end(), local_latencies.begin(), local_latencies.end());
+                failures += local_failures;
+            });
+        }
+
+        for (std::thread& client : clients) {
+            client.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "[*] Client: " << latencies.size() << " ok, " << failures << " failed in " << seconds << " s, "
+                  << latencies.size() / seconds << " req/s, p50 " << percentile(latencies, 50) << " us, p99 "
+                  << percentile(latencies, 99) << " us" << std::endl;
+        std::cout << "[*] Server: " << request_stats(info_fd) << std::endl;
+
+        ::close(info_fd);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -40,10 +40,12 @@ Matrix Matrix::dot_product(const Matrix& other) const {
 
     Matrix result(rows, other.columns);
 
+    //i-k-j order walks both mat2 and the result row by row (same summation order as i-j-k)
     for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < other.columns; j++) {
-            for (int k = 0; k < columns; k++) {
-                result(i, j) += (*this)(i, k) * other(k, j);
+        for (int k = 0; k < columns; k++) {
+            double val = (*this)(i, k);
+            for (int j = 0; j < other.columns; j++) {
+                result(i, j) += val * other(k, j);
             }
         }
     }
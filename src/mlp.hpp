@@ -4,15 +4,58 @@
 #include "layer.hpp"
 #include <vector>
 #include <cmath>
+#include <string>
+#include <fstream>
+#include <thread>
+#include <random>
+#include <algorithm>
+
+//Encoding of a layer's weights in the model file
+//Layers pruned to at least SPARSE_MIN_SPARSITY are stored sparse: CSR for element-wise pruning, BSR for block pruning,
+//with fp64 or bf16 values to match the dense encoding the model is saved with
+enum class WeightEncoding : int {
+    DENSE_F64  = 0, DENSE_BF16      = 1,
+    SPARSE_CSR = 2, SPARSE_BSR      = 3,
+    SPARSE_CSR_BF16 = 4, SPARSE_BSR_BF16 = 5
+};
+
+//First int of a tagged model file. Files without it are in the original untagged format
+//(num_layers, then rows, columns and fp64 weights for every layer)
+static constexpr int MODEL_FILE_MAGIC = 0x314E4E4D;
 
 class MLP {
 private:
     std::vector<Layer> layers;
+    Precision precision;
 
 public:
-    MLP(const std::vector<int>& layer_sizes) {
+    MLP(const std::vector<int>& layer_sizes, Precision precision = Precision::FP64) : precision(precision) {
         for (size_t i = 0; i < layer_sizes.size() - 1; ++i) {
-            layers.emplace_back(layer_sizes[i], layer_sizes[i + 1]);
+            layers.emplace_back(layer_sizes[i], layer_sizes[i + 1], precision);
+        }
+    }
+
+    //Switch between fp64 and bf16 (mixed precision) storage for every layer
+    void set_precision(Precision new_precision) {
+        precision = new_precision;
+        for (Layer& layer : layers) {
+            layer.set_precision(precision);
+        }
+    }
+
+    Precision get_precision() const {
+        return precision;
+    }
+
+    const std::vector<Layer>& get_layers() const {
+        return layers;
+    }
+
+    //Magnitude pruning of every layer, see magnitude_prune_mask(). Pruned weights stay zero through later
+    //train() calls, so the model can be fine-tuned afterwards. Sparse enough layers run sparse kernels in predict()
+    void prune(double sparsity, int block_size = 1) {
+        for (Layer& layer : layers) {
+            layer.prune(sparsity, block_size);
         }
     }
 
@@ -21,6 +64,7 @@ public:
             forward(inputs);
             backpropagate(targets, learning_rate);
         }
+        refresh_sparse();
     }
 
     //Call this method with batched sized inputs
@@ -39,37 +83,126 @@ public:
                 backpropagate(target_batch, learning_rate);
             }
         }
+        refresh_sparse();
+    }
+
+    //Lock-free asynchronous training (Hogwild!, Niu et al. 2011)
+    //Each thread owns a contiguous shard of the samples and runs per-sample (or small batch) forward/backward
+    //passes, updating the shared weights with relaxed atomics instead of locks (see Layer::backward).
+    //Works best on wide, sparse inputs where updates rarely collide
+    void train_hogwild(const Matrix& inputs, const Matrix& targets, double learning_rate, int epochs, int num_threads, int batch_size = 1) {
+        if (batch_size < 1) {
+            throw std::invalid_argument("[-] ERROR: Batch size must be at least 1");
+        }
+
+        int num_samples = inputs.get_rows();
+        num_threads = std::max(1, std::min(num_threads, num_samples));
+
+        std::vector<std::thread> workers;
+        for (int t = 0; t < num_threads; t++) {
+            workers.emplace_back([&, t]() {
+                //Shard boundaries for this thread
+                int shard_start = static_cast<long long>(num_samples) * t / num_threads;
+                int shard_end   = static_cast<long long>(num_samples) * (t + 1) / num_threads;
+
+                std::vector<int> batch_starts;
+                for (int start = shard_start; start < shard_end; start += batch_size) {
+                    batch_starts.push_back(start);
+                }
+
+                //Thread-local activations, one per layer
+                std::vector<Matrix> activations(layers.size(), Matrix(0, 0));
+                std::mt19937 gen(t);
+
+                for (int e = 0; e < epochs; e++) {
+                    std::shuffle(batch_starts.begin(), batch_starts.end(), gen);
+
+                    for (int start : batch_starts) {
+                        int end = std::min(start + batch_size, shard_end);
+
+                        Matrix input_batch  = inputs.get_submatrix(start, end);
+                        Matrix target_batch = targets.get_submatrix(start, end);
+
+                        forward(input_batch, activations);
+                        backpropagate(input_batch, activations, target_batch, learning_rate);
+                    }
+                }
+            });
+        }
+
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        //Cached weight copies are only invalidated here, not from the worker threads
+        for (Layer& layer : layers) {
+            layer.weights_changed();
+        }
+        refresh_sparse();
     }
 
     const Matrix predict(const Matrix& input) {
         forward(input);
-        return layers.back().get_outputs();
+        return network_outputs();
     }
 
-    //Might refactor for better performance maybe?
-    void save_model_binary(const std::string& filename) const {
+    //Saves as a tagged model file: MODEL_FILE_MAGIC, number of layers, then for every layer
+    //its encoding, rows, columns and weights. 'encoding' is DENSE_F64 or DENSE_BF16 and sets the value precision.
+    //Layers pruned to at least SPARSE_MIN_SPARSITY are stored as CSR or BSR in that precision; less sparse layers
+    //are stored dense, so their pruning mask is not kept
+    void save_model_binary(const std::string& filename, WeightEncoding encoding = WeightEncoding::DENSE_F64) const {
+        if (encoding != WeightEncoding::DENSE_F64 && encoding != WeightEncoding::DENSE_BF16) {
+            throw std::invalid_argument("[-] ERROR: Models are saved as DENSE_F64 or DENSE_BF16, pruned layers pick their sparse encoding");
+        }
+        bool bf16_values = (encoding == WeightEncoding::DENSE_BF16);
+
         std::ofstream file(filename, std::ios::binary);
         if (!file.is_open()) {
             throw std::runtime_error("[-] ERROR: Unable to open file '"+ filename + "' to save model");
         }
 
-        //Write number of layers (int format)
+        //Write magic and number of layers (int format)
+        int magic = MODEL_FILE_MAGIC;
         int num_layers = layers.size();
+        file.write(reinterpret_cast<const char*>(&magic), sizeof(int));
         file.write(reinterpret_cast<const char*>(&num_layers), sizeof(int));
         
         for (const Layer& layer : layers) {
             const Matrix& weights = layer.get_weights();
+            WeightEncoding layer_encoding = encoding;
+            if (layer.is_pruned() && mask_sparsity(layer.get_mask()) >= SPARSE_MIN_SPARSITY) {
+                if (layer.get_prune_block_size() > 1) layer_encoding = bf16_values ? WeightEncoding::SPARSE_BSR_BF16 : WeightEncoding::SPARSE_BSR;
+                else                                  layer_encoding = bf16_values ? WeightEncoding::SPARSE_CSR_BF16 : WeightEncoding::SPARSE_CSR;
+            }
+            int tag = static_cast<int>(layer_encoding);
             int rows = weights.get_rows(), cols = weights.get_columns();
 
-            //Write number of rows and columns (int format)
+            //Write encoding, number of rows and columns (int format)
+            file.write(reinterpret_cast<const char*>(&tag), sizeof(int));
             file.write(reinterpret_cast<const char*>(&rows), sizeof(int));
             file.write(reinterpret_cast<const char*>(&cols), sizeof(int));
 
-            //Write the weights (double format)
+            //Write the sparse weights (see CSRMatrix::write and BSRMatrix::write)
+            if (layer_encoding == WeightEncoding::SPARSE_CSR || layer_encoding == WeightEncoding::SPARSE_CSR_BF16) {
+                CSRMatrix::from_matrix(weights, layer.get_mask()).write(file, bf16_values);
+                continue;
+            }
+            if (layer_encoding == WeightEncoding::SPARSE_BSR || layer_encoding == WeightEncoding::SPARSE_BSR_BF16) {
+                BSRMatrix::from_matrix(weights, layer.get_mask(), layer.get_prune_block_size()).write(file, bf16_values);
+                continue;
+            }
+
+            //Write the weights (double or bf16 format)
             for (int i = 0; i < rows; ++i) {
                 for (int j = 0; j < cols; ++j) {
-                    double weight = weights(i, j);
-                    file.write(reinterpret_cast<const char*>(&weight), sizeof(double));
+                    if (bf16_values) {
+                        uint16_t weight = float_to_bf16(static_cast<float>(weights(i, j)));
+                        file.write(reinterpret_cast<const char*>(&weight), sizeof(uint16_t));
+                    }
+                    else {
+                        double weight = weights(i, j);
+                        file.write(reinterpret_cast<const char*>(&weight), sizeof(double));
+                    }
                 }
             }
         }
@@ -77,7 +210,7 @@ public:
         file.close();
     }
     
-    //Might refactor for better performance maybe?
+    //Loads tagged model files as well as the original untagged format
     void load_model_binary(const std::string& filename) {
         std::ifstream file(filename, std::ios::binary);
         if (!file.is_open()) {
@@ -87,22 +220,65 @@ public:
         int num_layers;
         file.read(reinterpret_cast<char*>(&num_layers), sizeof(int));
 
+        //Tagged files carry the number of layers after the magic
+        bool tagged = (num_layers == MODEL_FILE_MAGIC);
+        if (tagged) {
+            file.read(reinterpret_cast<char*>(&num_layers), sizeof(int));
+        }
+
         layers.clear();
         for (int l = 0; l < num_layers; ++l) {
+            int tag = static_cast<int>(WeightEncoding::DENSE_F64);
+            if (tagged) {
+                file.read(reinterpret_cast<char*>(&tag), sizeof(int));
+            }
+            if (tag < static_cast<int>(WeightEncoding::DENSE_F64) || tag > static_cast<int>(WeightEncoding::SPARSE_BSR_BF16)) {
+                throw std::runtime_error("[-] ERROR: Unknown weight encoding in model file '" + filename + "'");
+            }
+
             int rows, cols;
             file.read(reinterpret_cast<char*>(&rows), sizeof(int));
             file.read(reinterpret_cast<char*>(&cols), sizeof(int));
+
+            //Sparse layers restore their pruning mask from the stored pattern
+            WeightEncoding encoding = static_cast<WeightEncoding>(tag);
+            bool bf16_values = (encoding == WeightEncoding::SPARSE_CSR_BF16 || encoding == WeightEncoding::SPARSE_BSR_BF16);
+            if (encoding == WeightEncoding::SPARSE_CSR || encoding == WeightEncoding::SPARSE_CSR_BF16) {
+                CSRMatrix sparse = CSRMatrix::read(file, rows, cols, bf16_values);
+                layers.emplace_back(rows, cols, precision);
+                layers.back().set_weights(sparse.to_matrix());
+                layers.back().set_mask(sparse.to_mask());
+                continue;
+            }
+            if (encoding == WeightEncoding::SPARSE_BSR || encoding == WeightEncoding::SPARSE_BSR_BF16) {
+                BSRMatrix sparse = BSRMatrix::read(file, rows, cols, bf16_values);
+                layers.emplace_back(rows, cols, precision);
+                layers.back().set_weights(sparse.to_matrix());
+                layers.back().set_mask(sparse.to_mask(), sparse.get_block_size());
+                continue;
+            }
             
             Matrix weights(rows, cols);
             for (int i = 0; i < rows; ++i) {
                 for (int j = 0; j < cols; ++j) {
-                    double weight;
-                    file.read(reinterpret_cast<char*>(&weight), sizeof(double));
-                    weights(i, j) = weight;
+                    if (encoding == WeightEncoding::DENSE_BF16) {
+                        uint16_t weight;
+                        file.read(reinterpret_cast<char*>(&weight), sizeof(uint16_t));
+                        weights(i, j) = bf16_to_float(weight);
+                    }
+                    else {
+                        double weight;
+                        file.read(reinterpret_cast<char*>(&weight), sizeof(double));
+                        weights(i, j) = weight;
+                    }
                 }
             }
+
+            if (!file) {
+                throw std::runtime_error("[-] ERROR: Model file '" + filename + "' is truncated");
+            }
             
-            layers.emplace_back(rows, cols);
+            layers.emplace_back(rows, cols, precision);
             layers.back().set_weights(weights);
         }
         
@@ -113,13 +289,35 @@ private:
     void forward(const Matrix& input) {
         layers[0].forward(input);
         for (size_t i = 1; i < layers.size(); ++i) {
-            layers[i].forward(layers[i - 1].get_outputs());
+            if (precision == Precision::BF16) layers[i].forward(layers[i - 1].get_outputs_bf16());
+            else                              layers[i].forward(layers[i - 1].get_outputs());
+        }
+    }
+
+    //Outputs of the last layer after forward(), widened to fp64 in BF16
+    Matrix network_outputs() const {
+        if (precision == Precision::BF16) return layers.back().get_outputs_bf16().to_matrix();
+        return layers.back().get_outputs();
+    }
+
+    //Thread-safe forward pass used by train_hogwild, activations are written to the caller's buffers
+    void forward(const Matrix& input, std::vector<Matrix>& activations) const {
+        layers[0].forward(input, activations[0]);
+        for (size_t i = 1; i < layers.size(); ++i) {
+            layers[i].forward(activations[i - 1], activations[i]);
+        }
+    }
+
+    //Rebuild the sparse weights of pruned layers once training has changed them
+    void refresh_sparse() {
+        for (Layer& layer : layers) {
+            if (layer.is_pruned()) layer.refresh_sparse();
         }
     }
 
     void backpropagate(const Matrix& targets, double learning_rate) {
         //Calculate error at output layer
-        Matrix error = layers.back().get_outputs() - targets;
+        Matrix error = network_outputs() - targets;
 
         //Backpropagation through layers by iterating backwards
         for (size_t i = layers.size(); i-- > 0;) {
@@ -136,6 +334,28 @@ private:
             }
         }
     }
+
+    //Lock-free backpropagation used by train_hogwild, mirrors backpropagate() on the caller's activations
+    void backpropagate(const Matrix& input, const std::vector<Matrix>& activations, const Matrix& targets, double learning_rate) {
+        //Calculate error at output layer
+        Matrix error = activations.back() - targets;
+
+        //Backpropagation through layers by iterating backwards
+        for (size_t i = layers.size(); i-- > 0;) {
+            const Matrix& layer_input = (i == 0) ? input : activations[i - 1];
+
+            if (i == layers.size() - 1) {
+                //Output layer
+                layers[i].backward(layer_input, activations[i], error, learning_rate);
+            }
+            else {
+                //Hidden layers
+                Matrix hidden_error = layers[i + 1].propagate_error(error);
+                layers[i].backward(layer_input, activations[i], hidden_error, learning_rate);
+                error = hidden_error;
+            }
+        }
+    }
 };
 
 #endif
\ No newline at end of file
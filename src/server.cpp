@@ -0,0 +1,346 @@
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <sys/stat.h>
+#include "mlp.hpp"
+#include "inference.hpp"
+#include "server_protocol.hpp"
+
+//Local inference server with dynamic request batching
+//Loads a model file once, accepts requests on localhost (TCP or Unix socket) and coalesces concurrent
+//requests into batches: a batch is run as soon as it is full (max batch) or its oldest request has
+//waited for the latency budget. Batches run through the compiled InferenceExecutor on a worker pool
+
+using Clock = std::chrono::steady_clock;
+
+struct ServerOptions {
+    std::string model_file;
+    std::string unix_path;
+    int port           = DEFAULT_SERVER_PORT;
+    int max_batch      = 32;
+    int max_latency_us = 1000;
+    int workers        = std::max(1u, std::thread::hardware_concurrency());
+    int stats_interval = 10; //Seconds between stats lines, 0 to disable
+};
+
+//A single queued request, owned by the connection thread that waits on it
+struct PendingRequest {
+    const std::vector<double>* input;
+    std::vector<double>        output;
+    Clock::time_point          arrival;
+    bool                       done = false;
+};
+
+//Latency and throughput counters
+class ServerStats {
+private:
+    //Most recent latencies (microseconds), used for percentiles
+    static constexpr size_t WINDOW = 10000;
+
+    std::mutex          mutex;
+    std::vector<double> latencies;
+    size_t              next = 0;
+    uint64_t            requests = 0, batches = 0;
+    Clock::time_point   start = Clock::now();
+
+public:
+    void record_batch(const std::vector<PendingRequest*>& batch, Clock::time_point finished) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const PendingRequest* request : batch) {
+            double latency = std::chrono::duration<double, std::micro>(finished - request->arrival).count();
+            if (latencies.size() < WINDOW) latencies.push_back(latency);
+            else                           latencies[next] = latency;
+            next = (next + 1) % WINDOW;
+        }
+        requests += batch.size();
+        batches++;
+    }
+
+    std::string report() {
+        std::vector<double> window;
+        uint64_t total_requests, total_batches;
+        double seconds;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            window         = latencies;
+            total_requests = requests;
+            total_batches  = batches;
+            seconds        = std::chrono::duration<double>(Clock::now() - start).count();
+        }
+
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1)
+            << "requests " << total_requests << ", batches " << total_batches
+            << ", mean batch " << (total_batches ? static_cast<double>(total_requests) / total_batches : 0.0)
+            << ", throughput " << total_requests / seconds << " req/s since start"
+            << ", p50 " << percentile(window, 50) << " us, p99 " << percentile(window, 99) << " us"
+            << " (last " << window.size() << " requests)";
+        return out.str();
+    }
+};
+
+class BatchingServer {
+private:
+    ServerOptions options;
+    InferenceExecutor executor;
+    ServerStats stats;
+
+    std::mutex                  queue_mutex;
+    std::condition_variable     queue_cv; //Signalled when a request is queued
+    std::condition_variable     done_cv;  //Signalled when a batch finishes
+    std::deque<PendingRequest*> queue;
+
+public:
+    BatchingServer(const ServerOptions& options, const InferenceExecutor& executor) : options(options), executor(executor) {}
+
+    int get_input_size()  const { return executor.get_input_size(); }
+    int get_output_size() const { return executor.get_output_size(); }
+
+    ServerStats& get_stats() { return stats; }
+
+    //Queue a request and block until a worker has run it
+    void infer(const std::vector<double>& input, std::vector<double>& output) {
+        PendingRequest request;
+        request.input   = &input;
+        request.arrival = Clock::now();
+
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        queue.push_back(&request);
+        queue_cv.notify_one();
+        done_cv.wait(lock, [&]() { return request.done; });
+
+        output = std::move(request.output);
+    }
+
+    //Worker loop: form a batch under the latency budget, run it, wake its requests
+    void worker() {
+        //Every worker owns a copy of the executor (shared packed weights, own arena) and its buffers
+        InferenceExecutor local = executor;
+        const int in_size = local.get_input_size(), out_size = local.get_output_size();
+        std::vector<double> in(static_cast<size_t>(options.max_batch) * in_size);
+        std::vector<double> out(static_cast<size_t>(options.max_batch) * out_size);
+        std::vector<PendingRequest*> batch;
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+
+                //Wait for more requests until the batch is full or the oldest request's budget runs out.
+                //Re-checked on every wake up since another worker may have taken the queued requests
+                while (true) {
+                    queue_cv.wait(lock, [&]() { return !queue.empty(); });
+
+                    Clock::time_point deadline = queue.front()->arrival + std::chrono::microseconds(options.max_latency_us);
+                    if (static_cast<int>(queue.size()) >= options.max_batch || Clock::now() >= deadline) break;
+
+                    queue_cv.wait_until(lock, deadline);
+                }
+
+                batch.clear();
+                while (!queue.empty() && static_cast<int>(batch.size()) < options.max_batch) {
+                    batch.push_back(queue.front());
+                    queue.pop_front();
+                }
+
+                //Let another worker start on what is left
+                if (!queue.empty()) queue_cv.notify_one();
+            }
+
+            for (size_t r = 0; r < batch.size(); r++) {
+                std::copy(batch[r]->input->begin(), batch[r]->input->end(), in.begin() + r * in_size);
+            }
+
+            local.run(in.data(), batch.size(), out.data());
+
+            //Record before waking the requests, they are gone once their connection thread resumes
+            stats.record_batch(batch, Clock::now());
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                for (size_t r = 0; r < batch.size(); r++) {
+                    batch[r]->output.assign(out.begin() + r * out_size, out.begin() + (r + 1) * out_size);
+                    batch[r]->done = true;
+                }
+            }
+            done_cv.notify_all();
+        }
+    }
+
+    //Serve one client connection until it closes
+    void handle_connection(int fd) {
+        std::vector<double> input, output;
+        uint32_t type;
+
+        while (read_u32(fd, type)) {
+            bool ok = true;
+
+            if (type == REQUEST_INFER) {
+                uint32_t n;
+                if (!read_u32(fd, n)) break;
+
+                //Check the size before reading anything. A wrong-sized payload is drained so the connection stays
+                //in sync, one too large to be a real request closes the connection instead
+                if (static_cast<int>(n) != get_input_size()) {
+                    if (n > (1u << 24) || !discard_full(fd, static_cast<size_t>(n) * sizeof(double))) break;
+                    ok = send_error(fd, "input has " + std::to_string(n) + " values, model expects " + std::to_string(get_input_size()));
+                }
+                else {
+                    input.resize(n);
+                    if (!read_full(fd, input.data(), n * sizeof(double))) break;
+
+                    infer(input, output);
+                    ok = write_u32(fd, STATUS_OK) && write_u32(fd, output.size()) &&
+                         write_full(fd, output.data(), output.size() * sizeof(double));
+                }
+            }
+            else if (type == REQUEST_INFO) {
+                ok = write_u32(fd, STATUS_OK) && write_u32(fd, get_input_size()) && write_u32(fd, get_output_size());
+            }
+            else if (type == REQUEST_STATS) {
+                std::string report = stats.report();
+                ok = write_u32(fd, STATUS_OK) && write_u32(fd, report.size()) && write_full(fd, report.data(), report.size());
+            }
+            else {
+                send_error(fd, "unknown request type");
+                break;
+            }
+
+            if (!ok) break;
+        }
+
+        ::close(fd);
+    }
+
+private:
+    static bool send_error(int fd, const std::string& message) {
+        return write_u32(fd, STATUS_ERROR) && write_u32(fd, message.size()) && write_full(fd, message.data(), message.size());
+    }
+};
+
+//Listen on a Unix socket (if unix_path is set) or on TCP 127.0.0.1:port
+int listen_socket(const ServerOptions& options) {
+    int fd;
+    if (!options.unix_path.empty()) {
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) throw std::runtime_error("[-] ERROR: Unable to create socket");
+
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        options.unix_path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+        //Only remove a stale socket left by a previous run, never a regular file at that path
+        struct stat st;
+        if (::lstat(options.unix_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            ::unlink(options.unix_path.c_str());
+        }
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(fd);
+            throw std::runtime_error("[-] ERROR: Unable to bind '" + options.unix_path + "'");
+        }
+    }
+    else {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0) throw std::runtime_error("[-] ERROR: Unable to create socket");
+
+        int one = 1;
+        ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(options.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            ::close(fd);
+            throw std::runtime_error("[-] ERROR: Unable to bind localhost:" + std::to_string(options.port));
+        }
+    }
+
+    if (::listen(fd, 128) != 0) {
+        ::close(fd);
+        throw std::runtime_error("[-] ERROR: Unable to listen for connections");
+    }
+    return fd;
+}
+
+void print_usage(const char* name) {
+    std::cerr << "Usage: " << name << " <model file> [--port N | --unix PATH] [--max-batch N] [--max-latency-us N]"
+              << " [--workers N] [--stats-interval SECONDS]" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    ServerOptions options;
+    options.model_file = argv[1];
+    //Every flag takes a value; a missing or non-numeric one prints the usage
+    try {
+        for (int i = 2; i < argc; i += 2) {
+            if (i + 1 >= argc) throw std::invalid_argument(argv[i]);
+
+            std::string flag = argv[i], value = argv[i + 1];
+            if      (flag == "--port")           options.port           = std::stoi(value);
+            else if (flag == "--unix")           options.unix_path      = value;
+            else if (flag == "--max-batch")      options.max_batch      = std::stoi(value);
+            else if (flag == "--max-latency-us") options.max_latency_us = std::stoi(value);
+            else if (flag == "--workers")        options.workers        = std::stoi(value);
+            else if (flag == "--stats-interval") options.stats_interval = std::stoi(value);
+            else throw std::invalid_argument(flag);
+        }
+    }
+    catch (const std::exception&) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    try {
+        //Load the model once and compile it for batches of up to max_batch rows
+        MLP mlp({1, 1});
+        mlp.load_model_binary(options.model_file);
+        options.max_batch = std::max(1, options.max_batch);
+        BatchingServer server(options, InferenceExecutor::compile(mlp, options.max_batch));
+
+        int listen_fd = listen_socket(options);
+        std::cout << "[+] Serving '" << options.model_file << "' (" << server.get_input_size() << " inputs, "
+                  << server.get_output_size() << " outputs) on "
+                  << (options.unix_path.empty() ? "localhost:" + std::to_string(options.port) : options.unix_path)
+                  << ", max batch " << options.max_batch << ", max latency " << options.max_latency_us << " us, "
+                  << options.workers << " workers" << std::endl;
+
+        for (int w = 0; w < std::max(1, options.workers); w++) {
+            std::thread(&BatchingServer::worker, &server).detach();
+        }
+
+        if (options.stats_interval > 0) {
+            std::thread([&server, &options]() {
+                while (true) {
+                    std::this_thread::sleep_for(std::chrono::seconds(options.stats_interval));
+                    std::cout << "[*] " << server.get_stats().report() << std::endl;
+                }
+            }).detach();
+        }
+
+        //One thread per connection, each connection may have one request in flight
+        while (true) {
+            int client_fd = ::accept(listen_fd, nullptr, nullptr);
+            if (client_fd < 0) continue;
+
+            if (options.unix_path.empty()) {
+                int one = 1;
+                ::setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            }
+            std::thread(&BatchingServer::handle_connection, &server, client_fd).detach();
+        }
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef SERVER_PROTOCOL_H
+#define SERVER_PROTOCOL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+//Wire protocol between the inference server and its clients (host byte order, localhost only)
+//
+//Request:  uint32 type, then for INFER: uint32 n, n doubles
+//Response: uint32 status, then
+//  INFER: uint32 m, m doubles (the network outputs)
+//  INFO:  uint32 input size, uint32 output size
+//  STATS: uint32 length, length bytes of text
+//  On error: uint32 length, length bytes of message
+enum RequestType : uint32_t { REQUEST_INFER = 1, REQUEST_INFO = 2, REQUEST_STATS = 3 };
+enum ResponseStatus : uint32_t { STATUS_OK = 0, STATUS_ERROR = 1 };
+
+static constexpr int DEFAULT_SERVER_PORT = 7878;
+
+//Read/write exactly 'size' bytes, returns false if the connection closed or failed
+inline bool read_full(int fd, void* buffer, size_t size) {
+    char* ptr = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = ::recv(fd, ptr, size, 0);
+        if (n <= 0) return false;
+        ptr  += n;
+        size -= n;
+    }
+    return true;
+}
+
+//Read and drop 'size' bytes (the payload of a rejected request), returns false if the connection closed or failed
+inline bool discard_full(int fd, size_t size) {
+    char buffer[4096];
+    while (size > 0) {
+        size_t chunk = std::min(size, sizeof(buffer));
+        if (!read_full(fd, buffer, chunk)) return false;
+        size -= chunk;
+    }
+    return true;
+}
+
+inline bool write_full(int fd, const void* buffer, size_t size) {
+    const char* ptr = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = ::send(fd, ptr, size, MSG_NOSIGNAL);
+        if (n <= 0) return false;
+        ptr  += n;
+        size -= n;
+    }
+    return true;
+}
+
+inline bool write_u32(int fd, uint32_t value) {
+    return write_full(fd, &value, sizeof(value));
+}
+
+inline bool read_u32(int fd, uint32_t& value) {
+    return read_full(fd, &value, sizeof(value));
+}
+
+//Connect to the server on a Unix socket (if unix_path is set) or on TCP localhost:port
+inline int connect_to_server(const std::string& unix_path, int port) {
+    int fd;
+    if (!unix_path.empty()) {
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        unix_path.copy(addr.sun_path, sizeof(addr.sun_path) - 1);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            if (fd >= 0) ::close(fd);
+            throw std::runtime_error("[-] ERROR: Unable to connect to '" + unix_path + "'");
+        }
+    }
+    else {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family      = AF_INET;
+        addr.sin_port        = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            if (fd >= 0) ::close(fd);
+            throw std::runtime_error("[-] ERROR: Unable to connect to localhost:" + std::to_string(port));
+        }
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+//Percentile (0-100) of a set of samples, sorts them in place
+inline double percentile(std::vector<double>& samples, double p) {
+    if (samples.empty()) return 0.0;
+    std::sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(p / 100.0 * (samples.size() - 1) + 0.5);
+    return samples[std::min(index, samples.size() - 1)];
+}
+
+#endif
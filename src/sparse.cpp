@@ -0,0 +1,336 @@
+#include "sparse.hpp"
+#include "bf16.hpp"
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+PruneMask magnitude_prune_mask(const Matrix& weights, double sparsity, int block_size) {
+    if (sparsity < 0.0 || sparsity > 1.0) {
+        throw std::invalid_argument("[-] ERROR Sparse.cpp: Sparsity must be between 0 and 1");
+    }
+    if (block_size < 1) {
+        throw std::invalid_argument("[-] ERROR Sparse.cpp: Block size must be at least 1");
+    }
+
+    int rows = weights.get_rows(), cols = weights.get_columns();
+    int block_rows = (rows + block_size - 1) / block_size;
+    int block_cols = (cols + block_size - 1) / block_size;
+
+    //Score each block by its summed magnitude (a block of one is plain magnitude pruning)
+    std::vector<double> scores(static_cast<size_t>(block_rows) * block_cols, 0.0);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            scores[(i / block_size) * block_cols + j / block_size] += std::abs(weights(i, j));
+        }
+    }
+
+    //Find the smallest scoring blocks
+    size_t num_pruned = static_cast<size_t>(sparsity * scores.size() + 0.5);
+    std::vector<int> order(scores.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::nth_element(order.begin(), order.begin() + num_pruned, order.end(), [&](int a, int b) { return scores[a] < scores[b]; });
+
+    std::vector<bool> pruned(scores.size(), false);
+    for (size_t n = 0; n < num_pruned; n++) {
+        pruned[order[n]] = true;
+    }
+
+    PruneMask mask(static_cast<size_t>(rows) * cols);
+    for (int i = 0; i < rows; i++) {
+        for (int j = 0; j < cols; j++) {
+            mask[static_cast<size_t>(i) * cols + j] = pruned[(i / block_size) * block_cols + j / block_size] ? 0 : 1;
+        }
+    }
+
+    return mask;
+}
+
+double mask_sparsity(const PruneMask& mask) {
+    if (mask.empty()) return 0.0;
+
+    size_t zeros = std::count(mask.begin(), mask.end(), 0);
+    return static_cast<double>(zeros) / mask.size();
+}
+
+//= CSR =
+
+CSRMatrix CSRMatrix::from_matrix(const Matrix& mat, const PruneMask& mask) {
+    CSRMatrix result(mat.get_rows(), mat.get_columns());
+
+    for (int i = 0; i < mat.get_rows(); i++) {
+        for (int j = 0; j < mat.get_columns(); j++) {
+            if (mask[static_cast<size_t>(i) * result.columns + j]) {
+                result.col_index.push_back(j);
+                result.values.push_back(mat(i, j));
+            }
+        }
+        result.row_ptr[i + 1] = result.values.size();
+    }
+
+    return result;
+}
+
+Matrix CSRMatrix::to_matrix() const {
+    Matrix result(rows, columns);
+
+    for (int i = 0; i < rows; i++) {
+        for (int n = row_ptr[i]; n < row_ptr[i + 1]; n++) {
+            result(i, col_index[n]) = values[n];
+        }
+    }
+
+    return result;
+}
+
+PruneMask CSRMatrix::to_mask() const {
+    PruneMask result(static_cast<size_t>(rows) * columns, 0);
+
+    for (int i = 0; i < rows; i++) {
+        for (int n = row_ptr[i]; n < row_ptr[i + 1]; n++) {
+            result[static_cast<size_t>(i) * columns + col_index[n]] = 1;
+        }
+    }
+
+    return result;
+}
+
+Matrix CSRMatrix::lhs_dot_product(const Matrix& lhs) const {
+    if (lhs.get_columns() != rows) {
+        throw std::invalid_argument("[-] ERROR Sparse.cpp: Number of columns (mat1) is not the same as number of rows (mat2) for dot product");
+    }
+
+    Matrix result(lhs.get_rows(), columns);
+
+    //Each input value scales the stored entries of one row of this matrix
+    for (int s = 0; s < lhs.get_rows(); s++) {
+        for (int k = 0; k < rows; k++) {
+            double val = lhs(s, k);
+            if (val == 0.0) continue;
+
+            for (int n = row_ptr[k]; n < row_ptr[k + 1]; n++) {
+                result(s, col_index[n]) += val * values[n];
+            }
+        }
+    }
+
+    return result;
+}
+
+//Stored values of a sparse layer in the model file, fp64 or bf16
+static void write_values(std::ostream& out, const std::vector<double>& values, bool bf16_values) {
+    if (!bf16_values) {
+        out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+        return;
+    }
+
+    std::vector<uint16_t> packed(values.size());
+    for (size_t n = 0; n < values.size(); n++) {
+        packed[n] = float_to_bf16(static_cast<float>(values[n]));
+    }
+    out.write(reinterpret_cast<const char*>(packed.data()), packed.size() * sizeof(uint16_t));
+}
+
+static void read_values(std::istream& in, std::vector<double>& values, bool bf16_values) {
+    if (!bf16_values) {
+        in.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(double));
+        return;
+    }
+
+    std::vector<uint16_t> packed(values.size());
+    in.read(reinterpret_cast<char*>(packed.data()), packed.size() * sizeof(uint16_t));
+    for (size_t n = 0; n < values.size(); n++) {
+        values[n] = bf16_to_float(packed[n]);
+    }
+}
+
+void CSRMatrix::write(std::ostream& out, bool bf16_values) const {
+    int nnz = get_nnz();
+    out.write(reinterpret_cast<const char*>(&nnz), sizeof(int));
+    out.write(reinterpret_cast<const char*>(row_ptr.data()), row_ptr.size() * sizeof(int));
+    out.write(reinterpret_cast<const char*>(col_index.data()), col_index.size() * sizeof(int));
+    write_values(out, values, bf16_values);
+}
+
+CSRMatrix CSRMatrix::read(std::istream& in, int rows, int columns, bool bf16_values) {
+    CSRMatrix result(rows, columns);
+
+    int nnz = 0;
+    in.read(reinterpret_cast<char*>(&nnz), sizeof(int));
+    if (!in || nnz < 0 || static_cast<long long>(nnz) > static_cast<long long>(rows) * columns) {
+        throw std::runtime_error("[-] ERROR Sparse.cpp: Invalid CSR layer in model file");
+    }
+
+    result.col_index.resize(nnz);
+    result.values.resize(nnz);
+    in.read(reinterpret_cast<char*>(result.row_ptr.data()), result.row_ptr.size() * sizeof(int));
+    in.read(reinterpret_cast<char*>(result.col_index.data()), nnz * sizeof(int));
+    read_values(in, result.values, bf16_values);
+
+    //Reject anything that would index out of bounds
+    bool valid = static_cast<bool>(in) && result.row_ptr.front() == 0 && result.row_ptr.back() == nnz;
+    for (int i = 0; valid && i < rows; i++) {
+        valid = result.row_ptr[i] <= result.row_ptr[i + 1];
+    }
+    for (int n = 0; valid && n < nnz; n++) {
+        valid = result.col_index[n] >= 0 && result.col_index[n] < columns;
+    }
+    if (!valid) {
+        throw std::runtime_error("[-] ERROR Sparse.cpp: Invalid CSR layer in model file");
+    }
+
+    return result;
+}
+
+//= BSR =
+
+BSRMatrix BSRMatrix::from_matrix(const Matrix& mat, const PruneMask& mask, int block_size) {
+    BSRMatrix result(mat.get_rows(), mat.get_columns(), block_size);
+    int block_rows = (result.rows + block_size - 1) / block_size;
+    int block_cols = (result.columns + block_size - 1) / block_size;
+
+    for (int br = 0; br < block_rows; br++) {
+        for (int bc = 0; bc < block_cols; bc++) {
+            int row_end = std::min((br + 1) * block_size, result.rows);
+            int col_end = std::min((bc + 1) * block_size, result.columns);
+
+            //Keep the block if any of its entries survived pruning
+            bool keep = false;
+            for (int i = br * block_size; i < row_end && !keep; i++) {
+                for (int j = bc * block_size; j < col_end && !keep; j++) {
+                    keep = (mask[static_cast<size_t>(i) * result.columns + j] != 0);
+                }
+            }
+            if (!keep) continue;
+
+            result.block_col_index.push_back(bc);
+            size_t offset = result.values.size();
+            result.values.resize(offset + block_size * block_size, 0.0);
+            for (int i = br * block_size; i < row_end; i++) {
+                for (int j = bc * block_size; j < col_end; j++) {
+                    result.values[offset + (i - br * block_size) * block_size + (j - bc * block_size)] = mask[static_cast<size_t>(i) * result.columns + j] ? mat(i, j) : 0.0;
+                }
+            }
+        }
+        result.block_row_ptr[br + 1] = result.block_col_index.size();
+    }
+
+    return result;
+}
+
+Matrix BSRMatrix::to_matrix() const {
+    Matrix result(rows, columns);
+    int block_rows = block_row_ptr.size() - 1;
+
+    for (int br = 0; br < block_rows; br++) {
+        for (int n = block_row_ptr[br]; n < block_row_ptr[br + 1]; n++) {
+            const double* block = values.data() + static_cast<size_t>(n) * block_size * block_size;
+            int row_end = std::min((br + 1) * block_size, rows);
+            int col_end = std::min((block_col_index[n] + 1) * block_size, columns);
+
+            for (int i = br * block_size; i < row_end; i++) {
+                for (int j = block_col_index[n] * block_size; j < col_end; j++) {
+                    result(i, j) = block[(i - br * block_size) * block_size + (j - block_col_index[n] * block_size)];
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+PruneMask BSRMatrix::to_mask() const {
+    PruneMask result(static_cast<size_t>(rows) * columns, 0);
+    int block_rows = block_row_ptr.size() - 1;
+
+    for (int br = 0; br < block_rows; br++) {
+        for (int n = block_row_ptr[br]; n < block_row_ptr[br + 1]; n++) {
+            int row_end = std::min((br + 1) * block_size, rows);
+            int col_end = std::min((block_col_index[n] + 1) * block_size, columns);
+
+            for (int i = br * block_size; i < row_end; i++) {
+                for (int j = block_col_index[n] * block_size; j < col_end; j++) {
+                    result[static_cast<size_t>(i) * columns + j] = 1;
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+Matrix BSRMatrix::lhs_dot_product(const Matrix& lhs) const {
+    if (lhs.get_columns() != rows) {
+        throw std::invalid_argument("[-] ERROR Sparse.cpp: Number of columns (mat1) is not the same as number of rows (mat2) for dot product");
+    }
+
+    Matrix result(lhs.get_rows(), columns);
+    int block_rows = block_row_ptr.size() - 1;
+
+    for (int s = 0; s < lhs.get_rows(); s++) {
+        for (int br = 0; br < block_rows; br++) {
+            int row_end = std::min((br + 1) * block_size, rows);
+
+            for (int n = block_row_ptr[br]; n < block_row_ptr[br + 1]; n++) {
+                const double* block = values.data() + static_cast<size_t>(n) * block_size * block_size;
+                int col_start = block_col_index[n] * block_size;
+                int col_count = std::min(block_size, columns - col_start);
+
+                //Dense block_size x block_size product, the block is contiguous in memory
+                for (int i = br * block_size; i < row_end; i++) {
+                    double val = lhs(s, i);
+                    const double* block_row = block + (i - br * block_size) * block_size;
+                    for (int j = 0; j < col_count; j++) {
+                        result(s, col_start + j) += val * block_row[j];
+                    }
+                }
+            }
+        }
+    }
+
+    return result;
+}
+
+void BSRMatrix::write(std::ostream& out, bool bf16_values) const {
+    int num_blocks = get_num_blocks();
+    out.write(reinterpret_cast<const char*>(&block_size), sizeof(int));
+    out.write(reinterpret_cast<const char*>(&num_blocks), sizeof(int));
+    out.write(reinterpret_cast<const char*>(block_row_ptr.data()), block_row_ptr.size() * sizeof(int));
+    out.write(reinterpret_cast<const char*>(block_col_index.data()), block_col_index.size() * sizeof(int));
+    write_values(out, values, bf16_values);
+}
+
+BSRMatrix BSRMatrix::read(std::istream& in, int rows, int columns, bool bf16_values) {
+    int block_size = 0, num_blocks = 0;
+    in.read(reinterpret_cast<char*>(&block_size), sizeof(int));
+    in.read(reinterpret_cast<char*>(&num_blocks), sizeof(int));
+    if (!in || block_size < 1 || num_blocks < 0) {
+        throw std::runtime_error("[-] ERROR Sparse.cpp: Invalid BSR layer in model file");
+    }
+
+    BSRMatrix result(rows, columns, block_size);
+    int block_rows = (rows + block_size - 1) / block_size;
+    int block_cols = (columns + block_size - 1) / block_size;
+    if (static_cast<long long>(num_blocks) > static_cast<long long>(block_rows) * block_cols) {
+        throw std::runtime_error("[-] ERROR Sparse.cpp: Invalid BSR layer in model file");
+    }
+
+    result.block_col_index.resize(num_blocks);
+    result.values.resize(static_cast<size_t>(num_blocks) * block_size * block_size);
+    in.read(reinterpret_cast<char*>(result.block_row_ptr.data()), result.block_row_ptr.size() * sizeof(int));
+    in.read(reinterpret_cast<char*>(result.block_col_index.data()), num_blocks * sizeof(int));
+    read_values(in, result.values, bf16_values);
+
+    //Reject anything that would index out of bounds
+    bool valid = static_cast<bool>(in) && result.block_row_ptr.front() == 0 && result.block_row_ptr.back() == num_blocks;
+    for (int br = 0; valid && br < block_rows; br++) {
+        valid = result.block_row_ptr[br] <= result.block_row_ptr[br + 1];
+    }
+    for (int n = 0; valid && n < num_blocks; n++) {
+        valid = result.block_col_index[n] >= 0 && result.block_col_index[n] < block_cols;
+    }
+    if (!valid) {
+        throw std::runtime_error("[-] ERROR Sparse.cpp: Invalid BSR layer in model file");
+    }
+
+    return result;
+}
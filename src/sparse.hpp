@@ -0,0 +1,92 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "matrix.hpp"
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+//Pruned layers run the sparse kernels only from this sparsity up, below it dense execution is faster
+//(measured with bench/sparse_bench.cpp)
+static constexpr double SPARSE_MIN_SPARSITY = 0.65;
+
+//Pruning mask: one byte per weight, row-major (1 = keep, 0 = pruned)
+using PruneMask = std::vector<uint8_t>;
+
+//Build a pruning mask that removes the 'sparsity' fraction of smallest magnitude weights
+//With block_size > 1 whole block_size x block_size blocks are scored by their summed magnitude and pruned together
+PruneMask magnitude_prune_mask(const Matrix& weights, double sparsity, int block_size = 1);
+
+//Fraction of zero entries in a pruning mask
+double mask_sparsity(const PruneMask& mask);
+
+//Compressed sparse row matrix
+class CSRMatrix {
+private:
+    int rows, columns;
+
+    std::vector<int>    row_ptr;   //Start of each row in col_index/values, rows + 1 entries
+    std::vector<int>    col_index; //Column of each stored value
+    std::vector<double> values;
+
+public:
+    CSRMatrix(int rows = 0, int columns = 0) : rows(rows), columns(columns), row_ptr(rows + 1, 0) {};
+
+    //Convert from a dense matrix, keeping the entries where mask is non-zero
+    static CSRMatrix from_matrix(const Matrix& mat, const PruneMask& mask);
+
+    //Get methods
+    int get_rows()    const { return rows; }
+    int get_columns() const { return columns; }
+    int get_nnz()     const { return values.size(); }
+
+    //Convert back to a dense matrix, and the mask of stored entries
+    Matrix to_matrix() const;
+    PruneMask to_mask() const;
+
+    //Dot product lhs * this (SpMM with a dense left operand), returns matrix
+    Matrix lhs_dot_product(const Matrix& lhs) const;
+
+    //Binary (de)serialisation used by the model file: nnz, row_ptr, col_index, values
+    //Values are stored as fp64, or as bf16 when 'bf16_values' is set
+    void write(std::ostream& out, bool bf16_values = false) const;
+    static CSRMatrix read(std::istream& in, int rows, int columns, bool bf16_values = false);
+};
+
+//Block compressed sparse row matrix with square block_size x block_size blocks
+//Edge blocks are zero padded when the dimensions are not a multiple of block_size
+class BSRMatrix {
+private:
+    int rows, columns, block_size;
+
+    std::vector<int>    block_row_ptr;   //Start of each block row in block_col_index, block rows + 1 entries
+    std::vector<int>    block_col_index; //Block column of each stored block
+    std::vector<double> values;          //block_size * block_size row-major values per stored block
+
+public:
+    BSRMatrix(int rows = 0, int columns = 0, int block_size = 1)
+        : rows(rows), columns(columns), block_size(block_size), block_row_ptr((rows + block_size - 1) / block_size + 1, 0) {};
+
+    //Convert from a dense matrix, keeping the blocks where mask has any non-zero entry
+    static BSRMatrix from_matrix(const Matrix& mat, const PruneMask& mask, int block_size);
+
+    //Get methods
+    int get_rows()       const { return rows; }
+    int get_columns()    const { return columns; }
+    int get_block_size() const { return block_size; }
+    int get_num_blocks() const { return block_col_index.size(); }
+
+    //Convert back to a dense matrix, and the mask of stored blocks
+    Matrix to_matrix() const;
+    PruneMask to_mask() const;
+
+    //Dot product lhs * this (SpMM with a dense left operand), returns matrix
+    Matrix lhs_dot_product(const Matrix& lhs) const;
+
+    //Binary (de)serialisation used by the model file: block_size, num_blocks, block_row_ptr, block_col_index, values
+    //Values are stored as fp64, or as bf16 when 'bf16_values' is set
+    void write(std::ostream& out, bool bf16_values = false) const;
+    static BSRMatrix read(std::istream& in, int rows, int columns, bool bf16_values = false);
+};
+
+#endif